@@ -62,6 +62,7 @@ pub fn build(b: *std.build.Builder) void {
         "src/tex/primitive.c",
         "src/tex/printing.c",
         "src/tex/scanning.c",
+        "src/tex/shipout.c",
         "src/tex/stringpool.c",
         "src/tex/texdeffont.c",
         "src/tex/texfileio.c",
@@ -83,6 +84,7 @@ pub fn build(b: *std.build.Builder) void {
     exe.addIncludeDir("src");
     exe.linkLibC();
     exe.linkSystemLibrary("lua5.3");
+    exe.linkSystemLibrary("pthread");
     //exe.linkSystemLibrary("zlib");
     exe.linkLibrary(zig_part);
     exe.setTarget(target);
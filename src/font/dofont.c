@@ -21,6 +21,8 @@ with LuaTeX; if not, see <http://www.gnu.org/licenses/>.
 
 #include "ptexlib.h"
 #include "lua/luatex-api.h"
+#include <sys/stat.h>
+#include <unistd.h>
 
 /*tex
 
@@ -44,6 +46,216 @@ static char *font_error_message(pointer u, char *nom, scaled s)
     return str;
 }
 
+/*tex
+
+    When a cache directory is given on the command line, fonts that come from
+    a |define_font| callback are written there with the same routines that
+    put fonts in a format file. The file name is a hash of the requested name
+    and size and of the callback, and the file starts with these so that
+    collisions are detected. A next run then undumps the font instead of
+    running the callback. Virtual fonts refer to other font ids and fonts that
+    share their glyph tables depend on other fonts, so these are not cached.
+
+    The callback is identified by the chunk and line it is defined at. When
+    that chunk, or the font file that the callback reported, is newer than the
+    cache file (or gone) the cache is not used. A font without a file that can
+    be checked this way is not cached at all. Keep in mind that on a hit the
+    callback does not run, so it should not be the only place where a macro
+    package records what it knows about its fonts.
+
+*/
+
+#define font_cache_magic   0x466E7443 /* FntC */
+#define font_cache_version 2
+
+typedef struct font_cache_key {
+    const char *name;
+    scaled size;
+    char *callback;
+    time_t callback_time;
+} font_cache_key;
+
+static time_t font_cache_time(const char *fnam)
+{
+    struct stat st;
+    if (fnam == NULL || stat(fnam, &st) != 0)
+        return (time_t) -1;
+    return st.st_mtime;
+}
+
+static void set_font_cache_key(font_cache_key *k, int callback_id, const char *cnom, scaled s)
+{
+    lua_Debug ar;
+    int top = lua_gettop(Luas);
+    k->name = cnom;
+    k->size = s;
+    k->callback = NULL;
+    k->callback_time = (time_t) -1;
+    if (get_callback(Luas, callback_id) && lua_getinfo(Luas, ">S", &ar)) {
+        k->callback = xmalloc((unsigned) (strlen(ar.source) + 16));
+        sprintf(k->callback, "%s:%d", ar.source, ar.linedefined);
+        if (ar.source[0] == '@')
+            k->callback_time = font_cache_time(ar.source + 1);
+    }
+    lua_settop(Luas, top);
+}
+
+static char *font_cache_name(font_cache_key *k)
+{
+    /*tex A 64 bit FNV-1a hash of name, size and callback. */
+    uint64_t h = 0xcbf29ce484222325ULL;
+    const unsigned char *c = (const unsigned char *) k->name;
+    char *fnam;
+    int i;
+    while (*c) {
+        h = (h ^ *c++) * 0x100000001b3ULL;
+    }
+    for (i = 0; i < 4; i++) {
+        h = (h ^ ((unsigned) k->size >> (8 * i) & 0xFF)) * 0x100000001b3ULL;
+    }
+    c = (const unsigned char *) k->callback;
+    while (c != NULL && *c) {
+        h = (h ^ *c++) * 0x100000001b3ULL;
+    }
+    fnam = xmalloc((unsigned) (strlen(font_cache_dir) + 22));
+    sprintf(fnam, "%s/%08x%08x.fnt", font_cache_dir, (unsigned) (h >> 32), (unsigned) h);
+    return fnam;
+}
+
+static void dump_font_cache_string(const char *c)
+{
+    int x = (int) strlen(c) + 1;
+    dump_int(x);
+    dump_things(*c, x);
+}
+
+static boolean undump_font_cache_string(const char *c)
+{
+    int x;
+    char *d;
+    boolean ok;
+    undump_int(x);
+    if (x != (int) strlen(c) + 1)
+        return false;
+    d = xmalloc((unsigned) x);
+    undump_things(*d, x);
+    ok = (memcmp(c, d, (size_t) x) == 0);
+    free(d);
+    return ok;
+}
+
+static void dump_font_cache_header(font_cache_key *k, const char *ffnam)
+{
+    dump_int(font_cache_magic);
+    dump_int(font_cache_version);
+    dump_int((int) sizeof(texfont));
+    dump_int((int) sizeof(charinfo));
+    dump_int(k->size);
+    dump_font_cache_string(k->name);
+    dump_font_cache_string(k->callback);
+    dump_font_cache_string(ffnam);
+}
+
+static boolean undump_font_cache_header(font_cache_key *k, time_t made)
+{
+    int x;
+    char *c;
+    time_t t;
+    undump_int(x);
+    if (x != font_cache_magic)
+        return false;
+    undump_int(x);
+    if (x != font_cache_version)
+        return false;
+    undump_int(x);
+    if (x != (int) sizeof(texfont))
+        return false;
+    undump_int(x);
+    if (x != (int) sizeof(charinfo))
+        return false;
+    undump_int(x);
+    if (x != k->size)
+        return false;
+    if (!undump_font_cache_string(k->name) || !undump_font_cache_string(k->callback))
+        return false;
+    if (k->callback_time == (time_t) -1 || k->callback_time > made)
+        return false;
+    /*tex The font file that the callback reported when the cache was made. */
+    undump_int(x);
+    if (x <= 1)
+        return false;
+    c = xmalloc((unsigned) x);
+    undump_things(*c, x);
+    c[x - 1] = '\0';
+    t = font_cache_time(c);
+    free(c);
+    return t != (time_t) -1 && t <= made;
+}
+
+static void save_font_cache(int f, font_cache_key *k)
+{
+    FILE *cache;
+    char *fnam, *tnam;
+    if (font_type(f) == virtual_font_type || font_has_shared_glyphs(f))
+        return;
+    if (k->callback == NULL || k->callback_time == (time_t) -1 || font_cache_time(font_filename(f)) == (time_t) -1)
+        return;
+    fnam = font_cache_name(k);
+    tnam = xmalloc((unsigned) (strlen(fnam) + 5));
+    sprintf(tnam, "%s.tmp", fnam);
+    if (zopen_w_cache(&cache, tnam, "wb")) {
+        dump_font_cache_header(k, font_filename(f));
+        dump_font(f);
+        dump_int(font_cache_magic);
+        zclose_w_cache(cache);
+        /*tex A complete file or none at all, also when jobs run in parallel. */
+        if (rename(tnam, fnam) != 0)
+            remove(tnam);
+    }
+    free(tnam);
+    free(fnam);
+}
+
+static boolean load_font_cache(int f, font_cache_key *k)
+{
+    FILE *cache;
+    char *fnam;
+    int fd;
+    int x = 0;
+    time_t made;
+    boolean ok = false;
+    if (k->callback == NULL)
+        return false;
+    fnam = font_cache_name(k);
+    made = font_cache_time(fnam);
+    if (made != (time_t) -1 && zopen_w_cache(&cache, fnam, "rb")) {
+        /*tex
+            The undump routines read the descriptor directly, so that is what
+            is used here as well. First check the trailer so that a truncated
+            file is never undumped.
+        */
+        fd = fileno(cache);
+        if (lseek(fd, -(off_t) sizeof(int), SEEK_END) >= 0
+            && read(fd, &x, sizeof(int)) == (ssize_t) sizeof(int) && x == font_cache_magic
+            && lseek(fd, 0, SEEK_SET) == 0
+            && undump_font_cache_header(k, made)) {
+            /*tex Replace the fresh font by the cached one. */
+            delete_font(f);
+            undump_font(f);
+            if (f > max_font_id())
+                set_max_font_id(f);
+            /*tex These refer to things that only exist in the run that made the cache. */
+            set_font_cache_id(f, 0);
+            set_pdf_font_attr(f, 0);
+            font_instances(f) = 0;
+            ok = true;
+        }
+        zclose_w_cache(cache);
+    }
+    free(fnam);
+    return ok;
+}
+
 // TODO(mvlasak): delete \font completely
 static int do_define_font(int f, const char *cnom, scaled s, int natural_dir)
 {
@@ -51,6 +263,16 @@ static int do_define_font(int f, const char *cnom, scaled s, int natural_dir)
     char *cnam;
     int r, t;
     int callback_id = callback_defined(define_font_callback);
+    font_cache_key key;
+    key.callback = NULL;
+    if (font_cache_dir != NULL && callback_id > 0) {
+        set_font_cache_key(&key, callback_id, cnom, s);
+        if (load_font_cache(f, &key)) {
+            free(key.callback);
+            set_font_natural_dir(f, natural_dir);
+            return f;
+        }
+    }
     if (callback_id > 0) {
         cnam = xstrdup(cnom);
         callback_id = run_and_save_callback(callback_id, "Sdd->", cnam, s, f);
@@ -63,19 +285,25 @@ static int do_define_font(int f, const char *cnom, scaled s, int natural_dir)
             if (t == LUA_TTABLE) {
                 res = font_from_lua(Luas, f);
                 destroy_saved_callback(callback_id);
+                if (res && font_cache_dir != NULL) {
+                    save_font_cache(f, &key);
+                }
             } else if (t == LUA_TNUMBER) {
                 r = (int) lua_tointeger(Luas, -1);
                 destroy_saved_callback(callback_id);
                 delete_font(f);
                 lua_pop(Luas, 1);
+                free(key.callback);
                 return r;
             } else {
                 lua_pop(Luas, 1);
                 delete_font(f);
+                free(key.callback);
                 return 0;
             }
         }
     }
+    free(key.callback);
     if (res) {
         if (font_type(f) != virtual_font_type) {
             /*tex This implies \LUA. */
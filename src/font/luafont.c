@@ -147,23 +147,23 @@ int ff_checkoption (lua_State *L, int narg, const char *def, const char *const l
     lua_pushboolean(L, c); \
     lua_rawset(L, -3);
 
-static void dump_math_kerns(lua_State * L, charinfo * co, int l, int id)
+static void dump_math_kerns(lua_State * L, internal_font_number f, charinfo * co, int l, int id)
 {
     int i;
     for (i = 0; i < l; i++) {
         lua_newtable(L);
         if (id==top_left_kern) {
-            dump_intfield(L, height, co->top_left_math_kern_array[(2*i)]);
-            dump_intfield(L, kern,   co->top_left_math_kern_array[(2*i)+1]);
+            dump_intfield(L, height, font_scaled(f, co->top_left_math_kern_array[(2*i)]));
+            dump_intfield(L, kern,   font_scaled(f, co->top_left_math_kern_array[(2*i)+1]));
         } else if (id==top_right_kern) {
-            dump_intfield(L, height, co->top_right_math_kern_array[(2*i)]);
-            dump_intfield(L, kern,   co->top_right_math_kern_array[(2*i)+1]);
+            dump_intfield(L, height, font_scaled(f, co->top_right_math_kern_array[(2*i)]));
+            dump_intfield(L, kern,   font_scaled(f, co->top_right_math_kern_array[(2*i)+1]));
         } else if (id==bottom_right_kern) {
-            dump_intfield(L, height, co->bottom_right_math_kern_array[(2*i)]);
-            dump_intfield(L, kern,   co->bottom_right_math_kern_array[(2*i)+1]);
+            dump_intfield(L, height, font_scaled(f, co->bottom_right_math_kern_array[(2*i)]));
+            dump_intfield(L, kern,   font_scaled(f, co->bottom_right_math_kern_array[(2*i)+1]));
         } else if (id==bottom_left_kern) {
-            dump_intfield(L, height, co->bottom_left_math_kern_array[(2*i)]);
-            dump_intfield(L, kern,   co->bottom_left_math_kern_array[(2*i)+1]);
+            dump_intfield(L, height, font_scaled(f, co->bottom_left_math_kern_array[(2*i)]));
+            dump_intfield(L, kern,   font_scaled(f, co->bottom_left_math_kern_array[(2*i)+1]));
         }
         lua_rawseti(L, -2, (i + 1));
     }
@@ -174,20 +174,20 @@ static void font_char_to_lua(lua_State * L, internal_font_number f, charinfo * c
     liginfo *l;
     kerninfo *ki;
     lua_createtable(L, 0, 10);
-    dump_intfield(L,width,get_charinfo_width(co));
-    dump_intfield(L,height,get_charinfo_height(co));
-    dump_intfield(L,depth,get_charinfo_depth(co));
+    dump_intfield(L,width,font_scaled(f, get_charinfo_width(co)));
+    dump_intfield(L,height,font_scaled(f, get_charinfo_height(co)));
+    dump_intfield(L,depth,font_scaled(f, get_charinfo_depth(co)));
     if (get_charinfo_italic(co) != 0) {
-       dump_intfield(L,italic,get_charinfo_italic(co));
+       dump_intfield(L,italic,font_scaled(f, get_charinfo_italic(co)));
     }
     if (get_charinfo_vert_italic(co) != 0) {
-       dump_intfield(L,vert_italic,get_charinfo_vert_italic(co));
+       dump_intfield(L,vert_italic,font_scaled(f, get_charinfo_vert_italic(co)));
     }
     if (get_charinfo_top_accent(co) !=0 && get_charinfo_top_accent(co) != INT_MIN) {
-       dump_intfield(L,top_accent,get_charinfo_top_accent(co));
+       dump_intfield(L,top_accent,font_scaled(f, get_charinfo_top_accent(co)));
     }
     if (get_charinfo_bot_accent(co) != 0 && get_charinfo_bot_accent(co) != INT_MIN) {
-       dump_intfield(L,bot_accent,get_charinfo_bot_accent(co));
+       dump_intfield(L,bot_accent,font_scaled(f, get_charinfo_bot_accent(co)));
     }
     if (get_charinfo_ef(co) != 1000) {
         dump_intfield(L,expansion_factor,get_charinfo_ef(co));
@@ -224,9 +224,9 @@ static void font_char_to_lua(lua_State * L, internal_font_number f, charinfo * c
                 lua_createtable(L, 0, 5);
                 dump_intfield(L, glyph, h->glyph);
                 dump_intfield(L, extender, h->extender);
-                dump_intfield(L, start, h->start_overlap);
-                dump_intfield(L, end, h->end_overlap);
-                dump_intfield(L, advance, h->advance);
+                dump_intfield(L, start, font_scaled(f, h->start_overlap));
+                dump_intfield(L, end, font_scaled(f, h->end_overlap));
+                dump_intfield(L, advance, font_scaled(f, h->advance));
                 lua_rawseti(L, -2, i);
                 i++;
                 h = h->next;
@@ -242,9 +242,9 @@ static void font_char_to_lua(lua_State * L, internal_font_number f, charinfo * c
                 lua_createtable(L, 0, 5);
                 dump_intfield(L, glyph, h->glyph);
                 dump_intfield(L, extender, h->extender);
-                dump_intfield(L, start, h->start_overlap);
-                dump_intfield(L, end, h->end_overlap);
-                dump_intfield(L, advance, h->advance);
+                dump_intfield(L, start, font_scaled(f, h->start_overlap));
+                dump_intfield(L, end, font_scaled(f, h->end_overlap));
+                dump_intfield(L, advance, font_scaled(f, h->advance));
                 lua_rawseti(L, -2, i);
                 i++;
                 h = h->next;
@@ -269,7 +269,7 @@ static void font_char_to_lua(lua_State * L, internal_font_number f, charinfo * c
                     } else {
                         lua_pushinteger(L, kern_char(ki[i]));
                     }
-                    lua_pushinteger(L, kern_kern(ki[i]));
+                    lua_pushinteger(L, font_scaled(f, kern_kern(ki[i])));
                     lua_rawset(L, -3);
                 } else {
                     /*tex The first one wins. */
@@ -311,7 +311,7 @@ static void font_char_to_lua(lua_State * L, internal_font_number f, charinfo * c
             j++;
             lua_push_string_by_name(L,top_right);
             lua_newtable(L);
-            dump_math_kerns(L, co, i, top_right_kern);
+            dump_math_kerns(L, f, co, i, top_right_kern);
             lua_rawset(L, -3);
         }
         i = get_charinfo_math_kerns(co, top_left_kern);
@@ -319,7 +319,7 @@ static void font_char_to_lua(lua_State * L, internal_font_number f, charinfo * c
             j++;
             lua_push_string_by_name(L,top_left);
             lua_newtable(L);
-            dump_math_kerns(L, co, i, top_left_kern);
+            dump_math_kerns(L, f, co, i, top_left_kern);
             lua_rawset(L, -3);
         }
         i = get_charinfo_math_kerns(co, bottom_right_kern);
@@ -327,7 +327,7 @@ static void font_char_to_lua(lua_State * L, internal_font_number f, charinfo * c
             j++;
             lua_push_string_by_name(L,bottom_right);
             lua_newtable(L);
-            dump_math_kerns(L, co, i, bottom_right_kern);
+            dump_math_kerns(L, f, co, i, bottom_right_kern);
             lua_rawset(L, -3);
         }
         i = get_charinfo_math_kerns(co, bottom_left_kern);
@@ -335,7 +335,7 @@ static void font_char_to_lua(lua_State * L, internal_font_number f, charinfo * c
             j++;
             lua_push_string_by_name(L,bottom_left);
             lua_newtable(L);
-            dump_math_kerns(L, co, i, bottom_left_kern);
+            dump_math_kerns(L, f, co, i, bottom_left_kern);
             lua_rawset(L, -3);
         }
         if (j > 0)
@@ -1050,6 +1050,266 @@ static void font_char_from_lua(lua_State * L, internal_font_number f, int i, int
     }
 }
 
+/*tex
+
+    Handle font expansion last: the |copy_font| routine is called eventually,
+    and that needs to know |bc| and |ec|. We permits virtual fonts to use
+    expansion as one can always turn it off.
+
+*/
+
+static void read_lua_expansion(lua_State * L, int f)
+{
+    int fstep = lua_numeric_field_by_index(L, lua_key_index(step), 0);
+    if (fstep < 0)
+        fstep = 0;
+    if (fstep > 100)
+        fstep = 100;
+    if (fstep != 0) {
+        int fshrink = lua_numeric_field_by_index(L, lua_key_index(shrink), 0);
+        int fstretch= lua_numeric_field_by_index(L, lua_key_index(stretch), 0);
+        if (fshrink < 0)
+            fshrink = 0;
+        if (fshrink > 500)
+            fshrink = 500;
+        fshrink -= (fshrink % fstep);
+        if (fshrink < 0)
+            fshrink = 0;
+        if (fstretch < 0)
+            fstretch = 0;
+        if (fstretch > 1000)
+            fstretch = 1000;
+        fstretch -= (fstretch % fstep);
+        if (fstretch < 0)
+            fstretch = 0;
+        set_expand_params(f, fstretch, fshrink, fstep);
+    }
+}
+
+/*tex
+
+    Instead of a table the |characters| field can be a string with packed
+    character records. Kerns and ligatures then come as packed strings in the
+    |kerns| and |ligatures| fields of the font table. All values are native
+    32 bit integers, so in \LUA\ the records can be made with |string.pack|
+    using |"=i4i4i4i4i4i4"| and friends:
+
+    \starttabulate[|l|l|]
+    \NC characters \NC code width height depth italic index \NC \NR
+    \NC kerns      \NC left right kern                     \NC \NR
+    \NC ligatures  \NC left right replacement type         \NC \NR
+    \stoptabulate
+
+    The kerns and ligatures of one character have to be consecutive. This is
+    the format that |font.pack| returns.
+
+*/
+
+typedef struct packed_char {
+    int code;
+    int width;
+    int height;
+    int depth;
+    int italic;
+    int index;
+} packed_char;
+
+typedef struct packed_kern {
+    int left;
+    int right;
+    int kern;
+} packed_kern;
+
+typedef struct packed_lig {
+    int left;
+    int right;
+    int lig;
+    int type;
+} packed_lig;
+
+static void packed_chars_from_lua(lua_State * L, int f, int index)
+{
+    size_t l;
+    const char *b = lua_tolstring(L, index, &l);
+    int n = (int) (l / sizeof(packed_char));
+    int i;
+    int num = 0;
+    int bc = -1;
+    int ec = 0;
+    packed_char r;
+    charinfo *co;
+    for (i = 0; i < n; i++) {
+        memcpy(&r, b + i * sizeof(packed_char), sizeof(packed_char));
+        if (r.code > biggest_char) {
+            formatted_warning("font","lua-loaded font '%d' with name '%s' has an invalid character %d", f, font_name(f), r.code);
+        } else if (r.code >= 0) {
+            num++;
+            if (r.code > ec)
+                ec = r.code;
+            if (bc < 0 || r.code < bc)
+                bc = r.code;
+        }
+    }
+    if (bc == -1) {
+        formatted_warning("font","lua-loaded font '%d' with name '%s' has no characters", f, font_name(f));
+        return;
+    }
+    font_malloc_charinfo(f, num);
+    set_font_bc(f, bc);
+    set_font_ec(f, ec);
+    for (i = 0; i < n; i++) {
+        memcpy(&r, b + i * sizeof(packed_char), sizeof(packed_char));
+        if (r.code >= font_bc(f) && r.code <= font_ec(f)) {
+            co = get_charinfo(f, r.code);
+            co->width = r.width;
+            co->height = r.height;
+            co->depth = r.depth;
+            co->italic = r.italic;
+            co->index = (unsigned short) r.index;
+        }
+    }
+}
+
+static void packed_kerns_from_lua(lua_State * L, int f)
+{
+    size_t l;
+    const char *b;
+    int i, j, m, n;
+    packed_kern r;
+    kerninfo *ckerns;
+    lua_key_rawgeti(kerns);
+    if (lua_type(L, -1) == LUA_TSTRING) {
+        b = lua_tolstring(L, -1, &l);
+        n = (int) (l / sizeof(packed_kern));
+        i = 0;
+        while (i < n) {
+            int left;
+            memcpy(&r, b + i * sizeof(packed_kern), sizeof(packed_kern));
+            left = r.left;
+            for (j = i + 1; j < n; j++) {
+                memcpy(&r, b + j * sizeof(packed_kern), sizeof(packed_kern));
+                if (r.left != left)
+                    break;
+            }
+            if (left >= 0 && char_exists(f, left)) {
+                ckerns = xmalloc((unsigned) ((j - i + 1) * (int) sizeof(kerninfo)));
+                for (m = 0; i < j; i++, m++) {
+                    memcpy(&r, b + i * sizeof(packed_kern), sizeof(packed_kern));
+                    set_kern_item(ckerns[m], r.right, r.kern);
+                }
+                set_kern_item(ckerns[m], end_kern, 0);
+                set_charinfo_kerns(char_info(f, left), ckerns);
+            } else {
+                formatted_warning("font", "lua-loaded font %s char U+%X has an invalid kern field", font_name(f), left);
+                i = j;
+            }
+        }
+    }
+    lua_pop(L, 1);
+}
+
+static void packed_ligatures_from_lua(lua_State * L, int f)
+{
+    size_t l;
+    const char *b;
+    int i, j, m, n;
+    packed_lig r;
+    liginfo *cligs;
+    lua_key_rawgeti(ligatures);
+    if (lua_type(L, -1) == LUA_TSTRING) {
+        b = lua_tolstring(L, -1, &l);
+        n = (int) (l / sizeof(packed_lig));
+        i = 0;
+        while (i < n) {
+            int left;
+            memcpy(&r, b + i * sizeof(packed_lig), sizeof(packed_lig));
+            left = r.left;
+            for (j = i + 1; j < n; j++) {
+                memcpy(&r, b + j * sizeof(packed_lig), sizeof(packed_lig));
+                if (r.left != left)
+                    break;
+            }
+            if (left >= 0 && char_exists(f, left)) {
+                cligs = xmalloc((unsigned) ((j - i + 1) * (int) sizeof(liginfo)));
+                for (m = 0; i < j; i++, m++) {
+                    memcpy(&r, b + i * sizeof(packed_lig), sizeof(packed_lig));
+                    set_ligature_item(cligs[m], (char) ((r.type * 2) + 1), r.right, r.lig);
+                }
+                set_ligature_item(cligs[m], 0, end_ligature, 0);
+                set_charinfo_ligatures(char_info(f, left), cligs);
+            } else {
+                formatted_warning("font", "lua-loaded font %s char U+%X has an invalid ligature field", font_name(f), left);
+                i = j;
+            }
+        }
+    }
+    lua_pop(L, 1);
+}
+
+/*tex
+
+    The reverse operation, used by |font.pack|, pushes the three strings. The
+    dimensions are the ones seen by the typesetter, so scaled instances give
+    scaled values.
+
+*/
+
+int font_to_packed_lua(lua_State * L, int f)
+{
+    int c, k;
+    charinfo *co;
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    for (c = font_bc(f); c <= font_ec(f); c++) {
+        if (quick_char_exists(f, c)) {
+            packed_char r;
+            co = char_info(f, c);
+            r.code = c;
+            r.width = font_scaled(f, co->width);
+            r.height = font_scaled(f, co->height);
+            r.depth = font_scaled(f, co->depth);
+            r.italic = font_scaled(f, co->italic);
+            r.index = co->index;
+            luaL_addlstring(&b, (const char *) &r, sizeof(packed_char));
+        }
+    }
+    luaL_pushresult(&b);
+    luaL_buffinit(L, &b);
+    for (c = font_bc(f); c <= font_ec(f); c++) {
+        kerninfo *ki;
+        if (quick_char_exists(f, c) && (ki = get_charinfo_kerns(char_info(f, c))) != NULL) {
+            for (k = 0; !kern_end(ki[k]); k++) {
+                if (! kern_disabled(ki[k])) {
+                    packed_kern r;
+                    r.left = c;
+                    r.right = kern_char(ki[k]);
+                    r.kern = font_scaled(f, kern_kern(ki[k]));
+                    luaL_addlstring(&b, (const char *) &r, sizeof(packed_kern));
+                }
+            }
+        }
+    }
+    luaL_pushresult(&b);
+    luaL_buffinit(L, &b);
+    for (c = font_bc(f); c <= font_ec(f); c++) {
+        liginfo *li;
+        if (quick_char_exists(f, c) && (li = get_charinfo_ligatures(char_info(f, c))) != NULL) {
+            for (k = 0; !lig_end(li[k]); k++) {
+                if (! lig_disabled(li[k])) {
+                    packed_lig r;
+                    r.left = c;
+                    r.right = lig_char(li[k]);
+                    r.lig = lig_replacement(li[k]);
+                    r.type = lig_type(li[k]);
+                    luaL_addlstring(&b, (const char *) &r, sizeof(packed_lig));
+                }
+            }
+        }
+    }
+    luaL_pushresult(&b);
+    return 3;
+}
+
 /*tex
 
     The caller has to fix the state of the lua stack when there is an error!
@@ -1267,7 +1527,6 @@ int font_from_lua(lua_State * L, int f)
             lua_pop(L, 1);
         }
         if (bc != -1) {
-            int fstep;
             font_malloc_charinfo(f, num);
             set_font_bc(f, bc);
             set_font_ec(f, ec);
@@ -1291,38 +1550,7 @@ int font_from_lua(lua_State * L, int f)
                 lua_pop(L, 1);
             }
             lua_pop(L, 1);
-            /*tex
-
-                Handle font expansion last: the |copy_font| routine is called eventually,
-                and that needs to know |bc| and |ec|. We permits virtual fonts to use
-                expansion as one can always turn it off.
-
-            */
-            fstep = lua_numeric_field_by_index(L, lua_key_index(step), 0);
-            if (fstep < 0)
-                fstep = 0;
-            if (fstep > 100)
-                fstep = 100;
-            if (fstep != 0) {
-                int fshrink = lua_numeric_field_by_index(L, lua_key_index(shrink), 0);
-                int fstretch= lua_numeric_field_by_index(L, lua_key_index(stretch), 0);
-                if (fshrink < 0)
-                    fshrink = 0;
-                if (fshrink > 500)
-                    fshrink = 500;
-                fshrink -= (fshrink % fstep);
-                if (fshrink < 0)
-                    fshrink = 0;
-                if (fstretch < 0)
-                    fstretch = 0;
-                if (fstretch > 1000)
-                    fstretch = 1000;
-                fstretch -= (fstretch % fstep);
-                if (fstretch < 0)
-                    fstretch = 0;
-                set_expand_params(f, fstretch, fshrink, fstep);
-            }
-
+            read_lua_expansion(L, f);
         } else {
             formatted_warning("font","lua-loaded font '%d' with name '%s' has no characters", f, font_name(f));
         }
@@ -1334,6 +1562,27 @@ int font_from_lua(lua_State * L, int f)
             lua_pop(L, 1);
             set_font_cache_id(f, save_ref);
         }
+    } else if (lua_type(L, -1) == LUA_TSTRING) {
+        /*tex
+            The packed variant, the string is anchored while we read it. Then we
+            are back at the font table, just like after the loop above: the
+            kerns, ligatures and expansion are fields of the font, and the font
+            table is what |font_to_lua| expects in the cache.
+        */
+        int f_top = lua_gettop(L) - 1;
+        packed_chars_from_lua(L, f, -1);
+        lua_settop(L, f_top);
+        packed_kerns_from_lua(L, f);
+        packed_ligatures_from_lua(L, f);
+        read_lua_expansion(L, f);
+        if (save_ref > 0) {
+            /*tex This pops the table. */
+            r = luaL_ref(L, LUA_REGISTRYINDEX);
+            set_font_cache_id(f, r);
+        } else {
+            lua_pop(L, 1);
+            set_font_cache_id(f, save_ref);
+        }
     } else {
         formatted_warning("font","lua-loaded font '%d' with name '%s' has no character table", f, font_name(f));
     }
@@ -170,6 +170,11 @@ charinfo *get_charinfo(internal_font_number f, int c)
         glyph = get_sa_item(font_tables[f]->_characters, c).int_value;
         if (!glyph) {
             sa_tree_item sa_value = { 0 };
+            if (font_has_shared_glyphs(f)) {
+                /*tex Instances alias the tables so these can't be reallocated. */
+                formatted_error("font", "font %i shares its glyph tables, character U+%X can't be added", f, c);
+                return &(font_tables[f]->_charinfo[0]);
+            }
             int tglyph = ++font_tables[f]->_charinfo_count;
             if (tglyph >= font_tables[f]->_charinfo_size) {
                 font_malloc_charinfo(f, 256);
@@ -219,9 +224,9 @@ scaled_whd get_charinfo_whd(internal_font_number f, int c)
     scaled_whd s;
     charinfo *i;
     i = char_info(f, c);
-    s.wd = i->width;
-    s.dp = i->depth;
-    s.ht = i->height;
+    s.wd = font_scaled(f, i->width);
+    s.dp = font_scaled(f, i->depth);
+    s.ht = font_scaled(f, i->height);
     return s;
 }
 
@@ -807,13 +812,13 @@ scaled char_width(internal_font_number f, int c)
 {
     charinfo *ci = char_info(f, c);
     scaled w = get_charinfo_width(ci);
-    return w;
+    return font_scaled(f, w);
 }
 
 scaled calc_char_width(internal_font_number f, int c, int ex)
 {
     charinfo *ci = char_info(f, c);
-    scaled w = get_charinfo_width(ci);
+    scaled w = font_scaled(f, get_charinfo_width(ci));
     if (ex != 0)
         w = round_xn_over_d(w, 1000 + ex, 1000);
     return w;
@@ -823,40 +828,44 @@ scaled char_depth(internal_font_number f, int c)
 {
     charinfo *ci = char_info(f, c);
     scaled d = get_charinfo_depth(ci);
-    return d;
+    return font_scaled(f, d);
 }
 
 scaled char_height(internal_font_number f, int c)
 {
     charinfo *ci = char_info(f, c);
     scaled h = get_charinfo_height(ci);
-    return h;
+    return font_scaled(f, h);
 }
 
 scaled char_italic(internal_font_number f, int c)
 {
     charinfo *ci = char_info(f, c);
     scaled i = get_charinfo_italic(ci);
-    return i;
+    return font_scaled(f, i);
 }
 
 scaled char_vert_italic(internal_font_number f, int c)
 {
     charinfo *ci = char_info(f, c);
     scaled i = get_charinfo_vert_italic(ci);
-    return i;
+    return font_scaled(f, i);
 }
 
 scaled char_top_accent(internal_font_number f, int c)
 {
     charinfo *ci = char_info(f, c);
-    return get_charinfo_top_accent(ci);
+    scaled a = get_charinfo_top_accent(ci);
+    /*tex |INT_MIN| flags an absent accent position and is never scaled. */
+    return a == INT_MIN ? a : font_scaled(f, a);
 }
 
 scaled char_bot_accent(internal_font_number f, int c)
 {
     charinfo *ci = char_info(f, c);
-    return get_charinfo_bot_accent(ci);
+    scaled a = get_charinfo_bot_accent(ci);
+    /*tex |INT_MIN| flags an absent accent position and is never scaled. */
+    return a == INT_MIN ? a : font_scaled(f, a);
 }
 
 int char_remainder(internal_font_number f, int c)
@@ -937,10 +946,65 @@ void set_font_math_params(internal_font_number f, int b)
     }
 }
 
-void delete_font(int f)
+/*tex
+
+    The glyph tables of a font can be shared by scaled instances, see
+    |scale_font|. The owner keeps count of its instances and when it goes away
+    the tables are handed over to one of them.
+
+*/
+
+static void free_font_glyphs(int f)
 {
     int i;
     charinfo *co;
+    set_left_boundary(f, NULL);
+    set_right_boundary(f, NULL);
+    for (i = font_bc(f); i <= font_ec(f); i++) {
+        if (quick_char_exists(f, i)) {
+            co = char_info(f, i);
+            set_charinfo_name(co, NULL);
+            set_charinfo_tounicode(co, NULL);
+            set_charinfo_ligatures(co, NULL);
+            set_charinfo_kerns(co, NULL);
+            set_charinfo_vert_variants(co, NULL);
+            set_charinfo_hor_variants(co, NULL);
+        }
+    }
+    /*tex free |notdef| */
+    set_charinfo_name(font_tables[f]->_charinfo + 0, NULL);
+    free(font_tables[f]->_charinfo);
+    destroy_sa_tree(font_tables[f]->_characters);
+}
+
+static void release_font_glyphs(int f)
+{
+    int i;
+    int owner = 0;
+    if (font_shared(f) != 0) {
+        if (is_valid_font(font_shared(f)))
+            font_instances(font_shared(f))--;
+    } else if (font_instances(f) > 0) {
+        for (i = 1; i <= font_id_maxval; i++) {
+            if (i != f && font_tables[i] != NULL && font_shared(i) == f) {
+                if (owner == 0) {
+                    owner = i;
+                    font_shared(i) = 0;
+                    font_instances(i) = font_instances(f) - 1;
+                } else {
+                    font_shared(i) = owner;
+                }
+            }
+        }
+    } else {
+        free_font_glyphs(f);
+    }
+    font_tables[f]->_left_boundary = NULL;
+    font_tables[f]->_right_boundary = NULL;
+}
+
+void delete_font(int f)
+{
     assert(f > 0);
     if (font_tables[f] != NULL) {
         set_font_name(f, NULL);
@@ -951,23 +1015,7 @@ void delete_font(int f)
         set_font_area(f, NULL);
         set_font_cidregistry(f, NULL);
         set_font_cidordering(f, NULL);
-        set_left_boundary(f, NULL);
-        set_right_boundary(f, NULL);
-        for (i = font_bc(f); i <= font_ec(f); i++) {
-            if (quick_char_exists(f, i)) {
-                co = char_info(f, i);
-                set_charinfo_name(co, NULL);
-                set_charinfo_tounicode(co, NULL);
-                set_charinfo_ligatures(co, NULL);
-                set_charinfo_kerns(co, NULL);
-                set_charinfo_vert_variants(co, NULL);
-                set_charinfo_hor_variants(co, NULL);
-            }
-        }
-        /*tex free |notdef| */
-        set_charinfo_name(font_tables[f]->_charinfo + 0, NULL);
-        free(font_tables[f]->_charinfo);
-        destroy_sa_tree(font_tables[f]->_characters);
+        release_font_glyphs(f);
         free(param_base(f));
         if (math_param_base(f) != NULL)
             free(math_param_base(f));
@@ -979,6 +1027,93 @@ void delete_font(int f)
     }
 }
 
+/*tex
+
+    Scaled instances get their own header, parameters and size but use the
+    glyph tables of the font they are made from. Glyph dimensions are scaled
+    when they are fetched, using the size the shared metrics are expressed in.
+    Per glyph codes like |\efcode| live in the shared tables and so apply to
+    all instances.
+
+*/
+
+scaled scale_font_value(internal_font_number f, scaled v)
+{
+    int64_t d = font_scale_base(f);
+    int64_t n = (int64_t) v * font_size(f);
+    if (v == 0 || d == 0)
+        return v;
+    if (n < 0)
+        return (scaled) -((-n + d / 2) / d);
+    else
+        return (scaled) ((n + d / 2) / d);
+}
+
+static boolean is_scaled_math_param(int k)
+{
+    return ! (k == ScriptPercentScaleDown || k == ScriptScriptPercentScaleDown ||
+              k == RadicalDegreeBottomRaisePercent || k == NoLimitSubFactor || k == NoLimitSupFactor);
+}
+
+#define scale_font_param(v) (scaled) (((int64_t) (v) * atsize + (v < 0 ? -ds : ds) / 2) / ds)
+
+#define copy_font_string(a) if (tt->a != NULL) tt->a = xstrdup(tt->a)
+
+int scale_font(int id, int atsize)
+{
+    int f, k, i;
+    int ds = font_size(id);
+    texfont *tt;
+    if (ds <= 0 || atsize <= 0)
+        return 0;
+    f = new_font_id();
+    tt = xmalloc(sizeof(texfont));
+    memcpy(tt, font_tables[id], sizeof(texfont));
+    font_bytes += (int) sizeof(texfont);
+    font_tables[f] = tt;
+    copy_font_string(_font_name);
+    copy_font_string(_font_area);
+    copy_font_string(_font_filename);
+    copy_font_string(_font_fullname);
+    copy_font_string(_font_psname);
+    copy_font_string(_font_encodingname);
+    copy_font_string(_font_cidregistry);
+    copy_font_string(_font_cidordering);
+    /*tex The slant is a ratio, all other text parameters are dimensions. */
+    i = (int) (sizeof(*param_base(f)) * ((unsigned) font_params(id) + 2));
+    font_bytes += i;
+    param_base(f) = xmalloc((unsigned) i);
+    for (k = 0; k <= font_params(id); k++) {
+        scaled v = font_param(id, k);
+        font_param(f, k) = k == slant_code ? v : scale_font_param(v);
+    }
+    if (font_math_params(id) > 0) {
+        i = (int) (sizeof(*math_param_base(f)) * ((unsigned) font_math_params(id) + 2));
+        font_bytes += i;
+        math_param_base(f) = xmalloc((unsigned) i);
+        for (k = 0; k <= font_math_params(id); k++) {
+            scaled v = font_math_param(id, k);
+            if (v != undefined_math_parameter && is_scaled_math_param(k))
+                v = scale_font_param(v);
+            font_math_param(f, k) = v;
+        }
+    } else {
+        math_param_base(f) = NULL;
+    }
+    if (font_scale_base(id) == 0)
+        font_scale_base(f) = ds;
+    set_font_size(f, atsize);
+    set_font_used(f, 0);
+    set_font_touched(f, 0);
+    set_font_cache_id(f, 0);
+    set_pdf_font_num(f, 0);
+    if (font_shared(id) == 0)
+        font_shared(f) = id;
+    font_instances(f) = 0;
+    font_instances(font_shared(f))++;
+    return f;
+}
+
 void create_null_font(void)
 {
     int i = new_font();
@@ -1193,7 +1328,7 @@ scaled raw_get_kern(internal_font_number f, int lc, int rc)
             if (kern_disabled(u))
                 return 0;
             else
-                return kern_kern(u);
+                return font_scaled(f, kern_kern(u));
         }
         k++;
     }
@@ -1309,6 +1444,9 @@ static void dump_font_entry(texfont * f)
     dump_int(f->_hyphen_char);
     dump_int(f->_skew_char);
     dump_int(f->_font_natural_dir);
+    dump_int(f->_font_shared);
+    dump_int(f->_font_instances);
+    dump_int(f->_font_scale_base);
     dump_int(f->_font_params);
     dump_int(f->_font_math_params);
     dump_int(f->_ligatures_disabled);
@@ -1333,6 +1471,10 @@ void dump_font(int f)
     if (font_math_params(f) > 0) {
         dump_things(*math_param_base(f), (font_math_params(f) + 1 ));
     }
+    if (font_shared(f) != 0) {
+        /*tex The glyph tables are dumped with their owner. */
+        return;
+    }
     if (has_left_boundary(f)) {
         dump_int(1);
         dump_charinfo(f, left_boundarychar);
@@ -1473,6 +1615,9 @@ static void undump_font_entry(texfont * f)
     undump_int(x); f->_hyphen_char = x;
     undump_int(x); f->_skew_char = x;
     undump_int(x); f->_font_natural_dir = x;
+    undump_int(x); f->_font_shared = x;
+    undump_int(x); f->_font_instances = x;
+    undump_int(x); f->_font_scale_base = x;
     undump_int(x); f->_font_params = x;
     undump_int(x); f->_font_math_params = x;
     undump_int(x); f->_ligatures_disabled = x;
@@ -1512,6 +1657,10 @@ void undump_font(int f)
         math_param_base(f) = xmalloc((unsigned) i);
         undump_things(*math_param_base(f), (font_math_params(f) + 1));
     }
+    if (font_shared(f) != 0) {
+        /*tex The owner can come later, see |undump_font_instances|. */
+        return;
+    }
     /*tex stack size 1, default item value 0 */
     font_tables[f]->_characters = new_sa_tree(1, 1, sa_value);
     ci = xcalloc(1, sizeof(charinfo));
@@ -1533,6 +1682,24 @@ void undump_font(int f)
     }
 }
 
+/*tex Once all fonts are loaded the instances can pick up their glyph tables. */
+
+void undump_font_instances(void)
+{
+    int f, o;
+    for (f = 1; f <= max_font_id(); f++) {
+        if (font_tables[f] != NULL && font_shared(f) != 0) {
+            o = font_shared(f);
+            font_tables[f]->_characters = font_tables[o]->_characters;
+            font_tables[f]->_charinfo_count = font_tables[o]->_charinfo_count;
+            font_tables[f]->_charinfo_size = font_tables[o]->_charinfo_size;
+            font_tables[f]->_charinfo = font_tables[o]->_charinfo;
+            font_tables[f]->_left_boundary = font_tables[o]->_left_boundary;
+            font_tables[f]->_right_boundary = font_tables[o]->_right_boundary;
+        }
+    }
+}
+
 /*tex
 
     This one looks up the font for a \TFM\ with name |s| loaded at |fs| size and
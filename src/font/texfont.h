@@ -179,6 +179,9 @@ typedef struct texfont {
     int         _charinfo_count;
     int         _charinfo_size;
     charinfo   *_charinfo;
+    int         _font_shared;         /* font that owns the glyph tables we use, 0 when they are ours */
+    int         _font_instances;      /* number of scaled instances sharing our glyph tables */
+    int         _font_scale_base;     /* size the (shared) glyph metrics are expressed in, 0 when unscaled */
     int         _ligatures_disabled;
     int         _pdf_font_num;        /* maps to a PDF resource ID */
     str_number  _pdf_font_attr;       /* pointer to additional attributes */
@@ -378,6 +381,21 @@ boolean cmp_font_area(int, str_number);
 
 #  define charinfo_size(a)               font_tables[a]->_charinfo_size
 
+/*
+    A scaled instance shares the glyph tables of the font it was made from and
+    keeps the size these metrics are expressed in, so that dimensions can be
+    scaled when they are fetched.
+*/
+
+#  define font_shared(a)                 font_tables[a]->_font_shared
+#  define font_instances(a)              font_tables[a]->_font_instances
+#  define font_scale_base(a)             font_tables[a]->_font_scale_base
+#  define font_has_shared_glyphs(a)      (font_shared(a) != 0 || font_instances(a) != 0)
+
+#  define font_scaled(f,v)               (font_scale_base(f) == 0 ? (v) : scale_font_value(f,v))
+
+extern scaled scale_font_value(internal_font_number f, scaled v);
+
 #  define left_boundarychar  -1
 #  define right_boundarychar -2
 #  define non_boundarychar   -3
@@ -602,6 +620,7 @@ boolean is_valid_font(int id);
 
 void dump_font(int font_number);
 void undump_font(int font_number);
+void undump_font_instances(void);
 
 int test_no_ligatures(internal_font_number f);
 void set_no_ligatures(internal_font_number f);
@@ -181,8 +181,8 @@ void clear_patterns(struct tex_language *lang)
 
 void load_tex_patterns(int curlang, halfword head)
 {
-    char *s = tokenlist_to_cstring(head, 1, NULL);
-    load_patterns(get_language(curlang), (unsigned char *) s);
+    const char *s = tokenlist_to_tstring(head, 1, NULL);
+    load_patterns(get_language(curlang), (const unsigned char *) s);
 }
 
 #define STORE_CHAR(l,x) do { \
@@ -328,8 +328,8 @@ void clear_hyphenation(struct tex_language *lang)
 
 void load_tex_hyphenation(int curlang, halfword head)
 {
-    char *s = tokenlist_to_cstring(head, 1, NULL);
-    load_hyphenation(get_language(curlang), (unsigned char *) s);
+    const char *s = tokenlist_to_tstring(head, 1, NULL);
+    load_hyphenation(get_language(curlang), (const unsigned char *) s);
 }
 
 static halfword insert_discretionary(halfword t, halfword pre, halfword post, halfword replace, int penalty)
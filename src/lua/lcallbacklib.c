@@ -26,6 +26,8 @@
 int callback_count = 0;
 int saved_callback_count = 0;
 int direct_callback_count = 0;
+int direct_cache_hit_count = 0;
+int direct_cache_miss_count = 0;
 int late_callback_count = 0;
 int function_callback_count = 0;
 
@@ -89,6 +91,7 @@ static const char *const callbacknames[] = {
     "process_pdf_image_content",
     "provide_charproc_data",
     "input_level_string",
+    "shipout",
     NULL
 };
 
@@ -312,8 +315,7 @@ int do_run_callback(int special, const char *values, va_list vl)
                 lua_pushnumber(Luas, va_arg(vl, double));
                 break;
             case CALLBACK_STRNUMBER:       /* TeX string */
-                s = makeclstring(va_arg(vl, int), &len);
-                lua_pushlstring(Luas, s, len);
+                lua_push_str_number(Luas, va_arg(vl, int));
                 break;
             case CALLBACK_BOOLEAN: /* boolean */
                 lua_pushboolean(Luas, va_arg(vl, int));
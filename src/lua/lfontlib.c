@@ -113,8 +113,11 @@ static int setfont(lua_State * L)
     if (i) {
         luaL_checktype(L, t, LUA_TTABLE);
         if (is_valid_font(i)) {
-            if (! (font_touched(i) || font_used(i))) {
+            if (font_has_shared_glyphs(i)) {
+                luaL_error(L, "that font shares its glyph tables, changing it is forbidden");
+            } else if (! (font_touched(i) || font_used(i))) {
                 font_from_lua(L, i);
+                math_data_generation++;
             } else {
                 luaL_error(L, "that font has been accessed already, changing it is forbidden");
             }
@@ -132,7 +135,11 @@ static int addcharacters(lua_State * L)
     if (i) {
         luaL_checktype(L, t, LUA_TTABLE);
         if (is_valid_font(i)) {
+            if (font_has_shared_glyphs(i)) {
+                luaL_error(L, "that font shares its glyph tables, adding characters is forbidden");
+            }
             characters_from_lua(L, i);
+            math_data_generation++;
         } else {
             luaL_error(L, "that integer id is not a valid font");
         }
@@ -187,6 +194,23 @@ static int deffont(lua_State * L)
     return 0;                   /* not reached */
 }
 
+/* font.scale(id,size) : a new font that shares the glyph tables of id */
+
+static int scalefont(lua_State * L)
+{
+    int i = luaL_checkinteger(L, 1);
+    int s = luaL_checkinteger(L, 2);
+    if (i <= 0 || ! is_valid_font(i)) {
+        luaL_error(L, "that integer id is not a valid font");
+    } else if (s <= 0) {
+        luaL_error(L, "the size of a scaled font should be positive");
+    } else {
+        lua_pushinteger(L, scale_font(i, s));
+        return 1;
+    }
+    return 0;                   /* not reached */
+}
+
 /* this returns the expected (!) next fontid. */
 /* first arg true will keep the id */
 
@@ -219,6 +243,18 @@ static int getcopy(lua_State * L)
     return 1;
 }
 
+/* font.pack(id) : characters, kerns and ligatures as packed strings */
+
+static int packfont(lua_State * L)
+{
+    int i = luaL_checkinteger(L, 1);
+    if (i && is_valid_font(i)) {
+        return font_to_packed_lua(L, i);
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
 static int getparameters(lua_State * L)
 {
     int i = luaL_checkinteger(L, -1);
@@ -254,11 +290,13 @@ static const struct luaL_Reg fontlib[] = {
     {"each", tex_each_font},
     {"getfont", getfont},
     {"getcopy", getcopy},
+    {"pack", packfont},
     {"getparameters", getparameters},
     {"setfont", setfont},
     {"addcharacters", addcharacters},
     {"setexpansion", setexpansion},
     {"define", deffont},
+    {"scale", scalefont},
     {"nextid", nextfontid},
     {"id", getfontid},
     {"frozen", frozenfont},
@@ -87,14 +87,16 @@ void make_token_table(lua_State * L, int cmd, int chr, int cs)
     lua_rawseti(L, -2, 3);
 }
 
-static unsigned char *get_cs_text(int cs)
+/* a read-only view, hash strings are always zero terminated pool strings */
+
+static const unsigned char *get_cs_text(int cs)
 {
     if (cs == null_cs)
-        return (unsigned char *) xstrdup("\\csname\\endcsname");
-    else if ((cs_text(cs) < 0) || (cs_text(cs) >= str_ptr))
-        return (unsigned char *) xstrdup("");
+        return (const unsigned char *) "\\csname\\endcsname";
+    else if ((cs_text(cs) < STRING_OFFSET) || (cs_text(cs) >= str_ptr) || (str_string(cs_text(cs)) == NULL))
+        return (const unsigned char *) "";
     else
-        return (unsigned char *) makecstring(cs_text(cs));
+        return (const unsigned char *) str_string(cs_text(cs));
 }
 
 /* maybe this qualify as  a macro, not function */
@@ -335,13 +337,13 @@ static int run_scan_keyword_cs(lua_State * L)
 
 static int run_scan_csname(lua_State * L)
 {
-    unsigned char *s;
+    const unsigned char *s;
     int t;
     saved_tex_scanner texstate;
     save_tex_scanner(texstate);
     get_next();
     t = (cur_cs ? cs_token_flag + cur_cs : token_val(cur_cmd, cur_chr));
-    if (t >= cs_token_flag && ((s = get_cs_text(t - cs_token_flag)) != (unsigned char *) NULL)) {
+    if (t >= cs_token_flag && ((s = get_cs_text(t - cs_token_flag)) != (const unsigned char *) NULL)) {
         if (is_active_string(s))
             lua_pushstring(L, (char *) (s + 3));
         else
@@ -911,8 +913,8 @@ inline static int lua_tokenlib_get_csname(lua_State * L)
 {
     lua_token *n = check_istoken(L, 1);
     halfword t = token_info(n->token);
-    unsigned char *s;
-    if (t >= cs_token_flag && ((s = get_cs_text(t - cs_token_flag)) != (unsigned char *) NULL)) {
+    const unsigned char *s;
+    if (t >= cs_token_flag && ((s = get_cs_text(t - cs_token_flag)) != (const unsigned char *) NULL)) {
         if (is_active_string(s))
             lua_pushstring(L, (char *) (s + 3));
         else
@@ -942,13 +944,12 @@ inline static int lua_tokenlib_get_active(lua_State * L)
 {
     lua_token *n = check_istoken(L, 1);
     halfword t = token_info(n->token);
-    unsigned char *s;
-    if (t >= cs_token_flag && ((s = get_cs_text(t - cs_token_flag)) != (unsigned char *) NULL)) {
+    const unsigned char *s;
+    if (t >= cs_token_flag && ((s = get_cs_text(t - cs_token_flag)) != (const unsigned char *) NULL)) {
         if (is_active_string(s))
             lua_pushboolean(L,1);
         else
             lua_pushboolean(L,0);
-        free(s);
     } else {
         lua_pushboolean(L,0);
     }
@@ -1094,9 +1095,7 @@ static int get_meaning(lua_State * L)
         cmd = eq_type(cs);
         if (cmd >= call_cmd) {
             int chr = equiv(cs);
-            char *str = tokenlist_to_cstring(chr, true, NULL);
-            lua_pushstring(L, str);
-            free(str);
+            lua_pushstring(L, tokenlist_to_tstring(chr, true, NULL));
             return 1;
         }
     }
@@ -156,7 +156,7 @@
 #define nodelib_pushlist(L,n) { lua_pushinteger(L,n); lua_nodelib_push(L); }      /* can be: fast_metatable_or_nil(n) */
 #define nodelib_pushattr(L,n) { lua_pushinteger(L,n); lua_nodelib_push(L); }      /* can be: fast_metatable_or_nil(n) */
 #define nodelib_pushaction(L,n) { lua_pushinteger(L,n); lua_nodelib_push(L); }    /* can be: fast_metatable_or_nil(n) */
-#define nodelib_pushstring(L,n) { char *ss=makecstring(n); lua_pushstring(L,ss); free(ss); }
+#define nodelib_pushstring(L,n) lua_push_str_number(L,n)
 
 /* find prev, and fix backlinks .. can be a macro instead (only used a few times) */
 
@@ -1624,11 +1624,10 @@ static int lua_nodelib_direct_setleader(lua_State * L)
 
 #define get_write_direct_value(L,n) do {  \
     int l; \
-    char *s; \
+    const char *s; \
     expand_macros_in_tokenlist(n); \
-    s = tokenlist_to_cstring(def_ref, 1, &l); \
+    s = tokenlist_to_tstring(def_ref, 1, &l); \
     lua_pushlstring(L, s, (size_t) l); \
-    free(s); \
     flush_list(def_ref); \
 } while (0)
 
@@ -2784,6 +2783,349 @@ static int lua_nodelib_rangedimensions(lua_State * L) /* parent, first, last */
 
 /* node.direct.dimensions*/
 
+/* node.direct.collect and node.direct.scatter */
+
+/*
+    These walk a list (or a table of nodes) in C and read or write one or more
+    fields for all of them in one call, which saves a Lua to C call per node and
+    field in read-mostly passes. A field is given by name or, when it is a
+    number, is the value of that attribute.
+*/
+
+typedef enum {
+    bulk_id,
+    bulk_subtype,
+    bulk_char,
+    bulk_font,
+    bulk_lang,
+    bulk_width,
+    bulk_height,
+    bulk_depth,
+    bulk_shift,
+    bulk_kern,
+    bulk_penalty,
+    bulk_next,
+    bulk_prev,
+    bulk_list,
+    bulk_attr,
+    bulk_unknown,
+} bulk_fields;
+
+static const char *const bulk_field_names[] = {
+    "id", "subtype", "char", "font", "lang", "width", "height", "depth",
+    "shift", "kern", "penalty", "next", "prev", "list", "attr", NULL
+};
+
+/* returns the attribute number in |a| for numeric fields */
+
+static int nodelib_bulk_field(lua_State * L, int i, int *a)
+{
+    if (lua_type(L, i) == LUA_TNUMBER) {
+        *a = (int) lua_tointeger(L, i);
+        return bulk_attr;
+    } else if (lua_type(L, i) == LUA_TSTRING) {
+        const char *s = lua_tostring(L, i);
+        int f;
+        for (f = 0; bulk_field_names[f] != NULL; f++) {
+            if (strcmp(s, bulk_field_names[f]) == 0) {
+                *a = -1;
+                return f;
+            }
+        }
+    }
+    return bulk_unknown;
+}
+
+static void nodelib_bulk_get(lua_State * L, halfword n, int f, int a)
+{
+    halfword t = type(n);
+    switch (f) {
+        case bulk_id:
+            lua_pushinteger(L, t);
+            return;
+        case bulk_subtype:
+            lua_pushinteger(L, subtype(n));
+            return;
+        case bulk_char:
+            if (t == glyph_node) {
+                lua_pushinteger(L, character(n));
+                return;
+            }
+            break;
+        case bulk_font:
+            if (t == glyph_node) {
+                lua_pushinteger(L, font(n));
+                return;
+            }
+            break;
+        case bulk_lang:
+            if (t == glyph_node) {
+                lua_pushinteger(L, char_lang(n));
+                return;
+            }
+            break;
+        case bulk_width:
+            if (t == glyph_node) {
+                lua_pushinteger(L, char_width(font(n), character(n)));
+                return;
+            } else if (t == hlist_node || t == vlist_node || t == rule_node || t == glue_node ||
+                    t == math_node || t == kern_node || t == margin_kern_node || t == unset_node) {
+                lua_pushinteger(L, width(n));
+                return;
+            }
+            break;
+        case bulk_height:
+        case bulk_depth:
+            if (t == glyph_node) {
+                lua_pushinteger(L, f == bulk_height ? char_height(font(n), character(n)) : char_depth(font(n), character(n)));
+                return;
+            } else if (t == hlist_node || t == vlist_node || t == rule_node || t == unset_node) {
+                lua_pushinteger(L, f == bulk_height ? height(n) : depth(n));
+                return;
+            }
+            break;
+        case bulk_shift:
+            if (t == hlist_node || t == vlist_node) {
+                lua_pushinteger(L, shift_amount(n));
+                return;
+            }
+            break;
+        case bulk_kern:
+            if (t == kern_node || t == margin_kern_node) {
+                lua_pushinteger(L, width(n));
+                return;
+            } else if (t == math_node) {
+                lua_pushinteger(L, surround(n));
+                return;
+            }
+            break;
+        case bulk_penalty:
+            if (t == penalty_node) {
+                lua_pushinteger(L, penalty(n));
+                return;
+            } else if (t == disc_node) {
+                lua_pushinteger(L, disc_penalty(n));
+                return;
+            }
+            break;
+        case bulk_next:
+            lua_pushinteger(L, vlink(n));
+            return;
+        case bulk_prev:
+            lua_pushinteger(L, alink(n));
+            return;
+        case bulk_list:
+            if (t == hlist_node || t == vlist_node) {
+                lua_pushinteger(L, list_ptr(n));
+                return;
+            }
+            break;
+        case bulk_attr:
+            if (a >= 0) {
+                int v = has_attribute(n, a, UNUSED_ATTRIBUTE);
+                if (v != UNUSED_ATTRIBUTE) {
+                    lua_pushinteger(L, v);
+                    return;
+                }
+            } else if (nodetype_has_attributes(t)) {
+                lua_pushinteger(L, node_attr(n));
+                return;
+            }
+            break;
+    }
+    lua_pushnil(L);
+}
+
+static void nodelib_bulk_set(lua_State * L, halfword n, int f, int a, int i)
+{
+    halfword t = type(n);
+    halfword v = (halfword) lua_roundnumber(L, i);
+    switch (f) {
+        case bulk_subtype:
+            subtype(n) = (quarterword) v;
+            break;
+        case bulk_char:
+            if (t == glyph_node)
+                character(n) = v;
+            break;
+        case bulk_font:
+            if (t == glyph_node)
+                font(n) = v;
+            break;
+        case bulk_lang:
+            if (t == glyph_node)
+                set_char_lang(n, v);
+            break;
+        case bulk_width:
+            if (t == hlist_node || t == vlist_node || t == rule_node || t == glue_node ||
+                    t == math_node || t == kern_node || t == margin_kern_node || t == unset_node)
+                width(n) = v;
+            break;
+        case bulk_height:
+            if (t == hlist_node || t == vlist_node || t == rule_node || t == unset_node)
+                height(n) = v;
+            break;
+        case bulk_depth:
+            if (t == hlist_node || t == vlist_node || t == rule_node || t == unset_node)
+                depth(n) = v;
+            break;
+        case bulk_shift:
+            if (t == hlist_node || t == vlist_node)
+                shift_amount(n) = v;
+            break;
+        case bulk_kern:
+            if (t == kern_node || t == margin_kern_node)
+                width(n) = v;
+            else if (t == math_node)
+                surround(n) = v;
+            break;
+        case bulk_penalty:
+            if (t == penalty_node)
+                penalty(n) = v;
+            else if (t == disc_node)
+                disc_penalty(n) = v;
+            break;
+        case bulk_attr:
+            if (a >= 0 && nodetype_has_attributes(t))
+                set_attribute(n, a, v);
+            break;
+    }
+}
+
+/* count, nodes, values, ... = node.direct.collect(head,fields[,tables]) */
+
+static int lua_nodelib_direct_collect(lua_State * L)
+{
+    halfword n = (halfword) lua_tointeger(L, 1);
+    int nf, f, k, c = 0;
+    int *fields, *attrs;
+    luaL_checktype(L, 2, LUA_TTABLE);
+    nf = (int) lua_rawlen(L, 2);
+    luaL_checkstack(L, nf + 4, "out of stack space");
+    fields = xmalloc((unsigned) (2 * (nf + 1) * (int) sizeof(int)));
+    attrs = fields + nf + 1;
+    for (f = 1; f <= nf; f++) {
+        lua_rawgeti(L, 2, f);
+        fields[f] = nodelib_bulk_field(L, -1, &attrs[f]);
+        lua_pop(L, 1);
+        if (fields[f] == bulk_unknown) {
+            free(fields);
+            return luaL_error(L, "unknown field in collect");
+        }
+    }
+    /* the result tables, reused when given */
+    lua_settop(L, 3);
+    for (f = 0; f <= nf; f++) {
+        if (lua_type(L, 3) == LUA_TTABLE) {
+            if (lua_rawgeti(L, 3, f + 1) != LUA_TTABLE) {
+                lua_pop(L, 1);
+                lua_newtable(L);
+                lua_pushvalue(L, -1);
+                lua_rawseti(L, 3, f + 1);
+            }
+        } else {
+            lua_newtable(L);
+        }
+    }
+    while (n != null) {
+        c++;
+        lua_pushinteger(L, n);
+        lua_rawseti(L, 4, c);
+        for (f = 1; f <= nf; f++) {
+            nodelib_bulk_get(L, n, fields[f], attrs[f]);
+            lua_rawseti(L, 4 + f, c);
+        }
+        n = vlink(n);
+    }
+    /* terminate reused tables */
+    for (k = 0; k <= nf; k++) {
+        lua_pushnil(L);
+        lua_rawseti(L, 4 + k, c + 1);
+    }
+    free(fields);
+    lua_pushinteger(L, c);
+    lua_replace(L, 3);
+    return nf + 2;
+}
+
+/* node.direct.scatter(nodes,field,values[,count]) */
+
+static int lua_nodelib_direct_scatter(lua_State * L)
+{
+    int a, i, c;
+    int f = nodelib_bulk_field(L, 2, &a);
+    luaL_checktype(L, 1, LUA_TTABLE);
+    if (f == bulk_unknown || f == bulk_id || f == bulk_next || f == bulk_prev || f == bulk_list || (f == bulk_attr && a < 0)) {
+        return luaL_error(L, "field can't be set by scatter");
+    }
+    c = lua_type(L, 4) == LUA_TNUMBER ? (int) lua_tointeger(L, 4) : (int) lua_rawlen(L, 1);
+    lua_settop(L, 3);
+    for (i = 1; i <= c; i++) {
+        halfword n;
+        lua_rawgeti(L, 1, i);
+        n = (halfword) lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        if (n == null)
+            continue;
+        if (lua_type(L, 3) == LUA_TTABLE) {
+            /* one value per node, nil means untouched */
+            if (lua_rawgeti(L, 3, i) == LUA_TNUMBER)
+                nodelib_bulk_set(L, n, f, a, -1);
+            lua_pop(L, 1);
+        } else if (lua_type(L, 3) == LUA_TNUMBER) {
+            /* the same value for all nodes */
+            nodelib_bulk_set(L, n, f, a, 3);
+        }
+    }
+    return 0;
+}
+
+/* node.direct.hash */
+
+/*
+    Returns a structural hash of the list that is the same between runs, and a
+    boolean that is false when some content could not be taken into account.
+*/
+
+static int lua_nodelib_direct_hash(lua_State * L)
+{
+    int complete;
+    halfword n = (halfword) lua_tointeger(L, 1);
+    uint64_t h = hash_node_list(n, &complete);
+    lua_pushinteger(L, (lua_Integer) h);
+    lua_pushboolean(L, complete);
+    return 2;
+}
+
+/* node.direct.flatten_page */
+
+/*
+    Returns the glyphs of a box as one string of native integer quadruples
+    (left, baseline, font, char) plus their count, and the rules as (left, top,
+    width, height) plus their count, ready for string.unpack. Coordinates are
+    relative to the top left corner of the box, with the vertical one growing
+    downwards.
+*/
+
+static int lua_nodelib_direct_flatten_page(lua_State * L)
+{
+    halfword n = (halfword) lua_tointeger(L, 1);
+    flat_page f;
+    if (n == null || (type(n) != hlist_node && type(n) != vlist_node)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    memset(&f, 0, sizeof(flat_page));
+    flatten_page(n, &f);
+    lua_pushlstring(L, (const char *) f.glyphs, (size_t) f.glyph_count * sizeof(int));
+    lua_pushinteger(L, f.glyph_count / 4);
+    lua_pushlstring(L, (const char *) f.rules, (size_t) f.rule_count * sizeof(int));
+    lua_pushinteger(L, f.rule_count / 4);
+    free(f.glyphs);
+    free(f.rules);
+    return 4;
+}
+
 static int lua_nodelib_direct_dimensions(lua_State * L)
 {
     int top = lua_gettop(L);
@@ -4061,6 +4403,134 @@ static int lua_nodelib_direct_traverse_list(lua_State * L)
     return 3;
 }
 
+/* node.direct.traverse_filtered */
+
+/*
+    The filter is a table with the optional keys |id| (a type or a table of
+    types), |subtype|, |font| (only checked for glyphs), |attribute| with an
+    optional |value|, and |fields|, a list of fields as in |collect| that are
+    returned after the node. The filter is parsed once and kept as userdata, so
+    each step only runs the C predicate.
+*/
+
+#define max_filter_fields 16
+
+typedef struct node_filter {
+    uint64_t types;
+    int subtype;
+    int font;
+    int attribute;
+    int value;
+    int nf;
+    int fields[max_filter_fields];
+    int attrs[max_filter_fields];
+} node_filter;
+
+static int nodelib_direct_aux_next_masked(lua_State * L)
+{
+    halfword t;
+    int k;
+    node_filter *f = (node_filter *) lua_touserdata(L, lua_upvalueindex(1));
+    if (lua_isnil(L, 2)) {      /* first call */
+        t = lua_tointeger(L,1) ;
+        lua_settop(L,1);
+    } else {
+        t = lua_tointeger(L,2) ;
+        t = vlink(t);
+        lua_settop(L,2);
+    }
+    while (t != null) {
+        if (((f->types >> type(t)) & 1)
+            && (f->subtype < 0 || subtype(t) == f->subtype)
+            && (f->font < 0 || type(t) != glyph_node || font(t) == f->font)
+            && (f->attribute < 0 || has_attribute(t, f->attribute, f->value) != UNUSED_ATTRIBUTE)) {
+            break;
+        }
+        t = vlink(t);
+    }
+    if (t == null) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushinteger(L,t);
+    for (k = 0; k < f->nf; k++) {
+        nodelib_bulk_get(L, t, f->fields[k], f->attrs[k]);
+    }
+    return f->nf + 1;
+}
+
+static int lua_nodelib_direct_traverse_masked(lua_State * L)
+{
+    halfword n;
+    node_filter *f;
+    if (lua_isnil(L, 1)) {
+        lua_pushcclosure(L, nodelib_aux_nil, 0);
+        return 1;
+    }
+    n = (halfword) lua_tointeger(L, 1);
+    if (n == null) {
+        lua_pushcclosure(L, nodelib_aux_nil, 0);
+        return 1;
+    }
+    luaL_checktype(L, 2, LUA_TTABLE);
+    f = (node_filter *) lua_newuserdata(L, sizeof(node_filter));
+    f->types = 0;
+    f->subtype = -1;
+    f->font = -1;
+    f->attribute = -1;
+    f->value = UNUSED_ATTRIBUTE;
+    f->nf = 0;
+    if (lua_getfield(L, 2, "id") == LUA_TTABLE) {
+        int i, m = (int) lua_rawlen(L, -1);
+        for (i = 1; i <= m; i++) {
+            lua_rawgeti(L, -1, i);
+            f->types |= (uint64_t) 1 << get_valid_node_type_id(L, -1);
+            lua_pop(L, 1);
+        }
+    } else if (lua_isnil(L, -1)) {
+        f->types = ~ (uint64_t) 0;
+    } else {
+        f->types = (uint64_t) 1 << get_valid_node_type_id(L, -1);
+    }
+    lua_pop(L, 1);
+    if (lua_getfield(L, 2, "subtype") == LUA_TNUMBER) {
+        f->subtype = (int) lua_tointeger(L, -1);
+    }
+    lua_pop(L, 1);
+    if (lua_getfield(L, 2, "font") == LUA_TNUMBER) {
+        f->font = (int) lua_tointeger(L, -1);
+    }
+    lua_pop(L, 1);
+    if (lua_getfield(L, 2, "attribute") == LUA_TNUMBER) {
+        f->attribute = (int) lua_tointeger(L, -1);
+    }
+    lua_pop(L, 1);
+    if (lua_getfield(L, 2, "value") == LUA_TNUMBER) {
+        f->value = (int) lua_tointeger(L, -1);
+    }
+    lua_pop(L, 1);
+    if (lua_getfield(L, 2, "fields") == LUA_TTABLE) {
+        int i, m = (int) lua_rawlen(L, -1);
+        if (m > max_filter_fields) {
+            luaL_error(L, "too many fields in filter");
+        }
+        for (i = 1; i <= m; i++) {
+            lua_rawgeti(L, -1, i);
+            f->fields[i - 1] = nodelib_bulk_field(L, -1, &f->attrs[i - 1]);
+            lua_pop(L, 1);
+            if (f->fields[i - 1] == bulk_unknown) {
+                luaL_error(L, "unknown field in filter");
+            }
+        }
+        f->nf = m;
+    }
+    lua_pop(L, 1);
+    lua_pushcclosure(L, nodelib_direct_aux_next_masked, 1);
+    lua_pushinteger(L,n);
+    lua_pushnil(L);
+    return 3;
+}
+
 /* node.traverse */
 /* node.traverse_id */
 /* node.traverse_char */
@@ -6771,6 +7241,9 @@ static int lua_nodelib_fast_setfield(lua_State * L)
     } else if (t == attribute_node) {
         if (lua_key_eq(s, subtype)) {
             /* dummy subtype */
+        } else if (attr_interned(n)) {
+            /* shared by other nodes, use set_attribute or unset_attribute */
+            luaL_error(L,"You cannot set field %s in a shared attribute list",s);
         } else if (lua_key_eq(s, number)) {
             attribute_id(n) = (halfword) lua_tointeger(L, 3);
         } else if (lua_key_eq(s, value)) {
@@ -7469,6 +7942,9 @@ static int lua_nodelib_direct_setfield(lua_State * L)
     } else if (t == attribute_node) {
         if (lua_key_eq(s, subtype)) {
             /* dummy subtype */
+        } else if (attr_interned(n)) {
+            /* shared by other nodes, use set_attribute or unset_attribute */
+            luaL_error(L,"You cannot set field %s in a shared attribute list",s);
         } else if (lua_key_eq(s, number)) {
             attribute_id(n) = (halfword) lua_tointeger(L, 3);
         } else if (lua_key_eq(s, value)) {
@@ -7730,11 +8206,23 @@ static int lua_nodelib_properties_flush_table(lua_State * L)
         lua_settable(L,-5);
         lua_pop(L,1);
     }
+    memset(varmem_properties, 0, properties_bytes(var_mem_max));
     return 1;
 }
 
 /* maybe we should allocate a proper index 0..var_mem_max but not now */
 
+/* we keep track of nodes that have properties so that copy and free can skip the others */
+
+#define lua_nodelib_mark_property(L,n,i) do { \
+    if (n > 0 && n < var_mem_max) { \
+        if (lua_isnil(L,i)) \
+            reset_node_has_properties(n); \
+        else \
+            set_node_has_properties(n); \
+    } \
+} while (0)
+
 static int lua_nodelib_get_property(lua_State * L)
 {   /* <node> */
     halfword n = *((halfword *) lua_touserdata(L, 1));
@@ -7765,6 +8253,7 @@ static int lua_nodelib_set_property(lua_State * L)
     halfword n = *((halfword *) lua_touserdata(L, 1));
     if (n != null) {
         lua_settop(L,2);
+        lua_nodelib_mark_property(L,n,2);
         lua_get_metatablelua(node_properties);
         /* <node> <value> <propertytable> */
         lua_replace(L,-3);
@@ -7780,6 +8269,7 @@ static int lua_nodelib_direct_set_property(lua_State * L)
     halfword n = lua_tointeger(L, 1);
     if (n != null) {
         lua_settop(L,2);
+        lua_nodelib_mark_property(L,n,2);
         lua_get_metatablelua(node_properties);
         /* <node> <value> <propertytable> */
         lua_replace(L,1);
@@ -7791,6 +8281,8 @@ static int lua_nodelib_direct_set_property(lua_State * L)
 
 static int lua_nodelib_direct_properties_get_table(lua_State * L)
 {   /* <node|direct> */
+    /* from now on entries can be set without us knowing */
+    lua_properties_untracked = 1;
     lua_get_metatablelua(node_properties);
     return 1;
 }
@@ -7820,6 +8312,7 @@ static int lua_nodelib_set_property_t(lua_State * L)
     /* <table> <node> <value> */
     halfword n = *((halfword *) lua_touserdata(L, 2));
     if (n != null) {
+        lua_nodelib_mark_property(L,n,3);
         lua_get_metatablelua(node_properties);
         lua_insert(L, -2);
         lua_rawseti(L, -2, n);
@@ -8252,6 +8745,7 @@ static void lua_new_properties_table(lua_State * L)
 
 static const struct luaL_Reg direct_nodelib_f[] = {
     {"copy", lua_nodelib_direct_copy},
+    {"collect", lua_nodelib_direct_collect},
     {"copy_list", lua_nodelib_direct_copy_list},
     {"count", lua_nodelib_direct_count},
     {"current_attr", lua_nodelib_direct_currentattr},
@@ -8262,6 +8756,7 @@ static const struct luaL_Reg direct_nodelib_f[] = {
  /* {"family_font", lua_nodelib_mfont}, */ /* no node argument */
  /* {"fields", lua_nodelib_fields}, */ /* no node argument */
     {"first_glyph", lua_nodelib_direct_first_glyph},
+    {"flatten_page", lua_nodelib_direct_flatten_page},
     {"flush_list", lua_nodelib_direct_flush_list},
     {"flush_node", lua_nodelib_direct_flush_node},
     {"free", lua_nodelib_direct_free},
@@ -8296,6 +8791,7 @@ static const struct luaL_Reg direct_nodelib_f[] = {
     {"getsub", lua_nodelib_direct_getsub},
     {"getsup", lua_nodelib_direct_getsup},
     {"getdirection", lua_nodelib_direct_getdirection},
+    {"hash", lua_nodelib_direct_hash},
     {"has_glyph", lua_nodelib_direct_has_glyph},
     {"has_attribute", lua_nodelib_direct_has_attribute},
     {"get_attribute", lua_nodelib_direct_get_attribute},
@@ -8322,6 +8818,7 @@ static const struct luaL_Reg direct_nodelib_f[] = {
     {"protect_glyph", lua_nodelib_direct_protect_glyph},
     {"protrusion_skippable", lua_nodelib_direct_cp_skipable},
     {"remove", lua_nodelib_direct_remove},
+    {"scatter", lua_nodelib_direct_scatter},
     {"set_attribute", lua_nodelib_direct_set_attribute},
     {"setbox", lua_nodelib_direct_setbox},
     {"setfield", lua_nodelib_direct_setfield},
@@ -8365,6 +8862,7 @@ static const struct luaL_Reg direct_nodelib_f[] = {
     {"traverse_char", lua_nodelib_direct_traverse_char},
     {"traverse_glyph", lua_nodelib_direct_traverse_glyph},
     {"traverse_list", lua_nodelib_direct_traverse_list},
+    {"traverse_filtered", lua_nodelib_direct_traverse_masked},
  /* {"type", lua_nodelib_type}, */ /* no node argument */
  /* {"types", lua_nodelib_types}, */ /* no node argument */
     {"unprotect_glyphs", lua_nodelib_direct_unprotect_glyphs},
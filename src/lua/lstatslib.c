@@ -176,6 +176,7 @@ static struct statistic stats[] = {
     /* seldom or never accessed */
 
     {"total_pages", 'g', &total_pages},
+    {"output_bytes", 'g', &shipout_bytes},
     {"log_name", 'S', (void *) &getlogname},
     {"banner", 'S', (void *) &getbanner},
     {"luatex_version", 'G', &get_luatexversion},
@@ -201,6 +202,8 @@ static struct statistic stats[] = {
     {"pool_ptr", 'g', &pool_size},
     {"init_pool_ptr", 'g', &init_pool_ptr},
     {"pool_size", 'g', &pool_size},
+    {"reclaimed_strings", 'g', &reclaimed_string_count},
+    {"reclaimed_string_bytes", 'g', &reclaimed_string_bytes},
     {"var_mem_max", 'g', &var_mem_max},
     {"node_mem_usage", 'S', &sprint_node_mem_usage},
     {"fix_mem_max", 'g', &fix_mem_max},
@@ -222,6 +225,13 @@ static struct statistic stats[] = {
     {"save_size", 'g', &save_size},
     {"input_ptr", 'g', &input_ptr},
     {"largest_used_mark", 'g', &biggest_used_mark},
+    {"attribute_lists", 'g', &attribute_lists_interned},
+    {"glyph_runs", 'g', &glyph_runs_allocated},
+    {"paragraph_cache_hits", 'g', &paragraph_cache_hits},
+    {"max_expand_depth", 'g', &max_expand_depth_count},
+    {"csname_lookups", 'g', &csname_lookup_count},
+    {"csname_misses", 'g', &csname_miss_count},
+    {"csname_new_entries", 'g', &csname_new_count},
     {"luabytecodes", 'g', &luabytecode_max},
     {"luabytecode_bytes", 'g', &luabytecode_bytes},
     {"luastate_bytes", 'g', &luastate_bytes},
@@ -232,6 +242,8 @@ static struct statistic stats[] = {
     {"saved_callbacks", 'g', &saved_callback_count},
     {"late_callbacks", 'g', &late_callback_count},
     {"direct_callbacks", 'g', &direct_callback_count},
+    {"direct_cache_hits", 'g', &direct_cache_hit_count},
+    {"direct_cache_misses", 'g', &direct_cache_miss_count},
     {"function_callbacks", 'g', &function_callback_count},
 
     {"lc_ctype", 'S', (void *) &get_lc_ctype},
@@ -269,9 +281,7 @@ static int do_getstat(lua_State * L, int i)
     case 's':
         str = *(int *) (stats[i].value);
         if (str) {
-            char *ss = makecstring(str);
-            lua_pushstring(L, ss);
-            free(ss);
+            lua_push_str_number(L, str);
         } else {
             lua_pushnil(L);
         }
@@ -353,6 +363,72 @@ static int resetmessages(lua_State * L)
     return 0;
 }
 
+/*
+    status.setmacrostats(true) starts (or restarts) collecting macro statistics,
+    status.setmacrostats(false) stops it; status.getmacrostats(n) returns the n
+    most called macros, each as { name, calls, bytes, csnames }.
+*/
+
+static int setmacrostats(lua_State * L)
+{
+    set_macro_stats(lua_toboolean(L, 1));
+    return 0;
+}
+
+static int compare_macro_stats(const void *a, const void *b)
+{
+    int ca = macro_stats[*(const halfword *) a].calls;
+    int cb = macro_stats[*(const halfword *) b].calls;
+    return (ca < cb) ? 1 : ((ca > cb) ? -1 : 0);
+}
+
+static int getmacrostats(lua_State * L)
+{
+    int n = (int) luaL_optinteger(L, 1, 25);
+    int i, k = 0;
+    halfword *list;
+    if (macro_stats == NULL) {
+        lua_pushnil(L);
+        return 1;
+    }
+    list = xmalloc((unsigned) (eqtb_top + 1) * sizeof(halfword));
+    for (i = 0; i <= eqtb_top; i++) {
+        if (macro_stats[i].calls > 0)
+            list[k++] = i;
+    }
+    qsort(list, (size_t) k, sizeof(halfword), compare_macro_stats);
+    if (n <= 0 || n > k)
+        n = k;
+    lua_createtable(L, n, 0);
+    for (i = 0; i < n; i++) {
+        halfword cs = list[i];
+        lua_createtable(L, 0, 4);
+        if (cs == null_cs || cs_text(cs) < 0 || cs_text(cs) >= str_ptr) {
+            lua_pushliteral(L, "");
+        } else {
+            lua_push_str_number(L, cs_text(cs));
+        }
+        lua_setfield(L, -2, "name");
+        lua_pushinteger(L, macro_stats[cs].calls);
+        lua_setfield(L, -2, "calls");
+        lua_pushinteger(L, (lua_Integer) macro_stats[cs].tokens * (lua_Integer) sizeof(smemory_word));
+        lua_setfield(L, -2, "bytes");
+        lua_pushinteger(L, macro_stats[cs].csnames);
+        lua_setfield(L, -2, "csnames");
+        lua_rawseti(L, -2, i + 1);
+    }
+    xfree(list);
+    return 1;
+}
+
+/* status.collectstrings() flushes unreferenced strings and returns the number of bytes */
+
+static int collectstrings(lua_State * L)
+{
+    lua_pushinteger(L, collect_strings());
+    return 1;
+}
+
 static int setexitcode(lua_State * L) {
     defaultexitcode = luaL_checkinteger(L,1);
     return 0;
@@ -362,6 +438,9 @@ static const struct luaL_Reg statslib[] = {
     {"list", statslist},
     {"resetmessages", resetmessages},
     {"setexitcode", setexitcode},
+    {"collectstrings", collectstrings},
+    {"setmacrostats", setmacrostats},
+    {"getmacrostats", getmacrostats},
     {NULL, NULL}                /* sentinel */
 };
 
@@ -29,10 +29,16 @@ extern int unif_rand(int );
 extern int norm_rand(void );
 extern void init_randoms(int );
 
+/*
+    The strings, tokens and nodes printed from lua are collected in a spindle
+    per input level. A spindle has an array of ropes and one text arena that
+    the ropes point into by offset. Both are reset when the spindle is closed
+    but not freed, so after a while printing from lua no longer allocates.
+*/
+
 typedef struct {
-    char *text;
+    size_t text;                /* offset in the arena */
     unsigned int tsize;
-    void *next;
     boolean partial;
     int cattable;
     halfword tok;
@@ -40,8 +46,13 @@ typedef struct {
 } rope;
 
 typedef struct {
-    rope *head;
-    rope *tail;
+    rope *ropes;
+    int count;                  /* ropes written */
+    int index;                  /* ropes read */
+    int size;
+    char *arena;
+    size_t arena_used;
+    size_t arena_size;
     char complete;              /* currently still writing ? */
 } spindle;
 
@@ -57,17 +68,15 @@ static int spindle_index = 0;
 
 static int luac_store(lua_State * L, int i, int partial, int cattable)
 {
-    char *st = NULL;
+    const char *st = NULL;
     size_t tsize = 0;
+    size_t text = 0;
     rope *rn = NULL;
     halfword tok = null;
     halfword nod = null;
     int t = lua_type(L, i);
     if (t == LUA_TNUMBER || t == LUA_TSTRING) {
-        const char *sttemp;
-        sttemp = lua_tolstring(L, i, &tsize);
-        st = xmalloc((unsigned) (tsize + 1));
-        memcpy(st, sttemp, (tsize + 1));
+        st = lua_tolstring(L, i, &tsize);
     } else if (t == LUA_TUSERDATA) {
         void *p ;
         p = lua_touserdata(L, i);
@@ -96,21 +105,26 @@ static int luac_store(lua_State * L, int i, int partial, int cattable)
     }
     /* common */
     luacstrings++;
-    rn = (rope *) xmalloc(sizeof(rope));
-    rn->text = st;
+    if (st != NULL) {
+        if (write_spindle.arena_used + tsize >= write_spindle.arena_size) {
+            write_spindle.arena_size = 2 * write_spindle.arena_size + tsize + 1024;
+            write_spindle.arena = xrealloc(write_spindle.arena, (unsigned) write_spindle.arena_size);
+        }
+        text = write_spindle.arena_used;
+        memcpy(write_spindle.arena + text, st, tsize);
+        write_spindle.arena_used += tsize;
+    }
+    if (write_spindle.count == write_spindle.size) {
+        write_spindle.size = 2 * write_spindle.size + 64;
+        write_spindle.ropes = xrealloc(write_spindle.ropes, (unsigned) (sizeof(rope) * (unsigned) write_spindle.size));
+    }
+    rn = &write_spindle.ropes[write_spindle.count++];
+    rn->text = (st != NULL) ? text + 1 : 0; /* zero means: no text */
     rn->tsize = (unsigned) tsize;
     rn->tok = tok;
     rn->nod = nod;
-    rn->next = NULL;
     rn->partial = partial;
     rn->cattable = cattable;
-    /* add */
-    if (write_spindle.head == NULL) {
-        write_spindle.head = rn;
-    } else {
-        write_spindle.tail->next = rn;
-    }
-    write_spindle.tail = rn;
     write_spindle.complete = 0;
     return 1;
 }
@@ -241,49 +255,50 @@ static int luactprint(lua_State * L)
     return 0;
 }
 
+/* the rope that was read last */
+
+#define read_rope read_spindle.ropes[read_spindle.index - 1]
+
 int luacstring_cattable(void)
 {
-    return (int) read_spindle.tail->cattable;
+    return (int) read_rope.cattable;
 }
 
 int luacstring_partial(void)
 {
-    return read_spindle.tail->partial;
+    return read_rope.partial;
 }
 
 int luacstring_final_line(void)
 {
-    return (read_spindle.tail->next == NULL);
+    return (read_spindle.index == read_spindle.count);
 }
 
 int luacstring_input(halfword *n)
 {
-    rope *t = read_spindle.head;
+    rope *t;
     int ret = 1 ;
     if (!read_spindle.complete) {
         read_spindle.complete = 1;
-        read_spindle.tail = NULL;
+        read_spindle.index = 0;
     }
-    if (t == NULL) {
-        if (read_spindle.tail != NULL)
-            free(read_spindle.tail);
-        read_spindle.tail = NULL;
+    if (read_spindle.index == read_spindle.count) {
         return 0;
     }
-    if (t->text != NULL) {
+    t = &read_spindle.ropes[read_spindle.index++];
+    if (t->text > 0) {
         /* put that thing in the buffer */
-        char *st = t->text;
+        const char *st = read_spindle.arena + t->text - 1;
+        unsigned int tsize = t->tsize;
         int ret = first;
         last = first;
-        check_buffer_overflow(last + (int) t->tsize);
-        while (t->tsize-- > 0)
+        check_buffer_overflow(last + (int) tsize);
+        while (tsize-- > 0)
             buffer[last++] = (packed_ASCII_code) * st++;
         if (!t->partial) {
             while (last - 1 > ret && buffer[last - 1] == ' ')
                 last--;
         }
-        free(t->text);
-        t->text = NULL;
     } else if (t->tok > 0) {
         *n = t->tok;
         ret = 2;
@@ -291,12 +306,6 @@ int luacstring_input(halfword *n)
         *n = t->nod;
         ret = 3;
     }
-    if (read_spindle.tail != NULL) {
-        /* not a one-liner */
-        free(read_spindle.tail);
-    }
-    read_spindle.tail = t;
-    read_spindle.head = t->next;
     return ret;
 }
 
@@ -309,34 +318,19 @@ void luacstring_start(int n)
     if (spindle_size == spindle_index) {
         /* add a new one */
         spindles = xrealloc(spindles, (unsigned) (sizeof(spindle) * (unsigned) (spindle_size + 1)));
-        spindles[spindle_index].head = NULL;
-        spindles[spindle_index].tail = NULL;
-        spindles[spindle_index].complete = 0;
+        memset(&spindles[spindle_index], 0, sizeof(spindle));
         spindle_size++;
     }
 }
 
-/* close for reading */
+/* close for reading, the memory is kept for the next round */
 
 void luacstring_close(int n)
 {
-    rope *next, *t;
     (void) n; /* for -W */
-    next = read_spindle.head;
-    while (next != NULL) {
-        if (next->text != NULL)
-            free(next->text);
-        t = next;
-        next = next->next;
-        if (t==read_spindle.tail) {
-            read_spindle.tail = NULL;
-        }
-        free(t);
-    }
-    read_spindle.head = NULL;
-    if (read_spindle.tail != NULL)
-        free(read_spindle.tail);
-    read_spindle.tail = NULL;
+    read_spindle.count = 0;
+    read_spindle.index = 0;
+    read_spindle.arena_used = 0;
     read_spindle.complete = 0;
     spindle_index--;
 }
@@ -1185,14 +1179,11 @@ static int scantoks(lua_State * L)
 
 static int gettoks(lua_State * L)
 {
-    char *ss;
     str_number t;
     int k = get_item_index(L, lua_gettop(L), toks_base);
     check_index_range(k, "gettoks");
     t = get_tex_toks_register(k);
-    ss = makecstring(t);
-    lua_pushstring(L, ss);
-    free(ss);
+    lua_push_str_number(L, t);
     flush_str(t);
     return 1;
 }
@@ -1219,9 +1210,7 @@ static int getmark(lua_State *L)
                 ptr = split_bot_marks_array[num];
             }
             if (ptr) {
-                char *str = tokenlist_to_cstring(ptr, 1, NULL);
-                lua_pushstring(L, str);
-                free(str);
+                lua_pushstring(L, tokenlist_to_tstring(ptr, 1, NULL));
                 return 1;
             }
         }
@@ -1806,9 +1795,8 @@ static int settex(lua_State * L)
 
 static int do_convert(lua_State * L, int cur_code)
 {
-    int texstr;
+    int texstr = 0;
     int i = -1;
-    char *str = NULL;
     switch (cur_code) {
         /* ignored (yet) */
 
@@ -1841,16 +1829,12 @@ static int do_convert(lua_State * L, int cur_code)
             /* no backend here */
             if (cur_code < 32) {
                 texstr = the_convert_string(cur_code, i);
-                if (texstr) {
-                    str = makecstring(texstr);
-                    flush_str(texstr);
-                }
             }
     }
     /* end */
-    if (str) {
-        lua_pushstring(L, str);
-        free(str);
+    if (texstr) {
+        lua_push_str_number(L, texstr);
+        flush_str(texstr);
     } else {
         lua_pushnil(L);
     }
@@ -1861,7 +1845,6 @@ static int do_scan_internal(lua_State * L, int cur_cmd1, int cur_code, int value
 {
     int texstr;
     int retval = 1 ;
-    char *str = NULL;
     int save_cur_val, save_cur_val_level;
     save_cur_val = cur_val;
     save_cur_val_level = cur_val_level;
@@ -1891,13 +1874,7 @@ static int do_scan_internal(lua_State * L, int cur_cmd1, int cur_code, int value
             break;
         default:
             texstr = the_scanned_result();
-            str = makecstring(texstr);
-            if (str) {
-                lua_pushstring(L, str);
-                free(str);
-            } else {
-                lua_pushnil(L);
-            }
+            lua_push_str_number(L, texstr);
             flush_str(texstr);
             break;
     }
@@ -2569,9 +2546,7 @@ static int tex_hashpairs(lua_State * L)
     while (cs < hash_size) {
         s = hash_text(cs);
         if (s > 0) {
-            char *ss = makecstring(s);
-            lua_pushstring(L, ss);
-            free(ss);
+            lua_push_str_number(L, s);
             cmd = eq_type(cs);
             chr = equiv(cs);
             make_token_table(L, cmd, chr, cs);
@@ -2591,9 +2566,7 @@ static int tex_primitives(lua_State * L)
     while (cs < prim_size) {
         s = get_prim_text(cs);
         if (s > 0) {
-            char *ss = makecstring(s);
-            lua_pushstring(L, ss);
-            free(ss);
+            lua_push_str_number(L, s);
             cmd = get_prim_eq_type(cs);
             chr = get_prim_equiv(cs);
             make_token_table(L, cmd, chr, 0);
@@ -2635,9 +2608,7 @@ static int tex_extraprimitives(lua_State * L)
         s = get_prim_text(cs);
         if (s > 0) {
             if (get_prim_origin(cs) & mask) {
-                char *ss = makecstring(s);
-                lua_pushstring(L, ss);
-                free(ss);
+                lua_push_str_number(L, s);
                 lua_rawseti(L, -2, i++);
             }
         }
@@ -2658,16 +2629,12 @@ static int tex_hashpairs(lua_State * L)
         s = hash_text(cs);
         if (s > 0) {
             halfword n = cs_next(cs);
-            char *ss = makecstring(s);
-            lua_pushstring(L, ss);
-            free(ss);
+            lua_push_str_number(L, s);
             lua_rawseti(L, -2, ++nt);
             while (n) {
                 s = cs_text(n);
                 if (s) {
-                    ss = makecstring(s);
-                    lua_pushstring(L, ss);
-                    free(ss);
+                    lua_push_str_number(L, s);
                     lua_rawseti(L, -2, ++nt);
                 }
                 n = cs_next(n);
@@ -2687,9 +2654,7 @@ static int tex_primitives(lua_State * L)
     while (cs < prim_size) {
         s = get_prim_text(cs);
         if (s > 0) {
-            char *ss = makecstring(s);
-            lua_pushstring(L, ss);
-            free(ss);
+            lua_push_str_number(L, s);
             lua_rawseti(L, -2, ++nt);
         }
         cs++;
@@ -2728,9 +2693,7 @@ static int tex_extraprimitives(lua_State * L)
         s = get_prim_text(cs);
         if (s > 0) {
             if (get_prim_origin(cs) & mask) {
-                char *ss = makecstring(s);
-                lua_pushstring(L, ss);
-                free(ss);
+                lua_push_str_number(L, s);
                 lua_rawseti(L, -2, ++nt);
             }
         }
@@ -3558,10 +3521,8 @@ int luaopen_tex(lua_State * L)
     lua_settable(L, -3);
     lua_setmetatable(L, -2);    /* meta to itself */
     /* initialize the I/O stack: */
-    spindles = xmalloc(sizeof(spindle));
+    spindles = xcalloc(1, sizeof(spindle));
     spindle_index = 0;
-    spindles[0].head = NULL;
-    spindles[0].tail = NULL;
     spindle_size = 1;
     /* a somewhat odd place for this assert, maybe */
     if (command_names[data_cmd].id != data_cmd) {
@@ -59,6 +59,7 @@ const_string LUATEX_IHELP[] = {
     "   --[no-]file-line-error        disable/enable file:line:error style messages",
     "   --[no-]file-line-error-style  aliases of --[no-]file-line-error",
     "   --fmt=FORMAT                  load the format file FORMAT",
+    "   --font-cache=DIR              keep loaded fonts in DIR for later runs",
     "   --halt-on-error               stop processing at the first error",
     "   --help                        display help and exit",
     "   --ini                         be ini" my_name ", for dumping formats",
@@ -112,6 +113,7 @@ static void prepare_cmdline(lua_State * L, char **av, int ac, int zero_offset)
 
 
 char *startup_filename = NULL;
+char *font_cache_dir = NULL;
 int lua_only = 0;
 int lua_offset = 0;
 unsigned char show_luahashchars = 0;
@@ -122,6 +124,7 @@ extern int myoptind;
 
 static struct optparse_long longopts[] = {
     {"fmt", 'f', OPTPARSE_REQUIRED},
+    {"font-cache", 'C', OPTPARSE_REQUIRED},
     {"lua", 'l', OPTPARSE_REQUIRED},
     {"interaction", 'I', OPTPARSE_REQUIRED},
     {"jobname", 'j', OPTPARSE_REQUIRED},
@@ -161,6 +164,9 @@ static void parse_options(int ac, char **av)
         case 'f': // --fmt
             dump_name = options.optarg;
             break;
+        case 'C': // --font-cache
+            font_cache_dir = options.optarg;
+            break;
         case 'l': // --lua
             startup_filename = options.optarg;
             lua_offset = (options.optind - 1);
@@ -320,34 +320,104 @@ int lua_traceback(lua_State * L)
     return 1;
 }
 
-void luatokencall(int p, int nameptr)
+/*tex
+
+    Macros that wrap \.{\\directlua} can pass the same code thousands of times,
+    so the compiled chunks are kept (as registry references) in a small table
+    indexed by a hash of the code and the chunk name. The code itself is kept
+    too so that a hash collision never runs the wrong chunk.
+
+*/
+
+#define lua_chunk_cache_size 256
+
+typedef struct lua_chunk_cache_entry {
+    unsigned hash;
+    int ref;
+    size_t size;
+    char *code;
+    char *name;
+} lua_chunk_cache_entry;
+
+static lua_chunk_cache_entry lua_chunk_cache[lua_chunk_cache_size] = { { 0, 0, 0, NULL, NULL } };
+
+static unsigned lua_chunk_hash(const char *s, size_t l, const char *name)
+{
+    unsigned h = 2166136261U;
+    size_t i;
+    for (i = 0; i < l; i++)
+        h = (h ^ (unsigned char) s[i]) * 16777619U;
+    while (*name)
+        h = (h ^ (unsigned char) *name++) * 16777619U;
+    return h;
+}
+
+/*tex
+
+    This pushes the compiled chunk or an error message and returns the
+    |lua_load| status.
+
+*/
+
+static int load_cached_chunk(lua_State * L, const char *s, size_t l, const char *name)
 {
+    unsigned h = lua_chunk_hash(s, l, name);
+    lua_chunk_cache_entry *c = &lua_chunk_cache[h % lua_chunk_cache_size];
     LoadS ls;
+    int i;
+    if (c->code != NULL && c->hash == h && c->size == l && memcmp(c->code, s, l) == 0 && strcmp(c->name, name) == 0) {
+        ++direct_cache_hit_count;
+        lua_rawgeti(L, LUA_REGISTRYINDEX, c->ref);
+        return 0;
+    }
+    ++direct_cache_miss_count;
+    ls.s = (char *) s;
+    ls.size = l;
+    i = Luas_load(L, getS, &ls, name);
+    if (i == 0) {
+        if (c->code != NULL) {
+            luaL_unref(L, LUA_REGISTRYINDEX, c->ref);
+            xfree(c->code);
+            xfree(c->name);
+        }
+        lua_pushvalue(L, -1);
+        c->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        c->hash = h;
+        c->size = l;
+        c->code = xmalloc((unsigned) l);
+        memcpy(c->code, s, l);
+        c->name = xstrdup(name);
+    }
+    return i;
+}
+
+void luatokencall(int p, int nameptr)
+{
     int i;
     int l = 0;
-    char *s = NULL;
-    char *lua_id;
+    const char *s = NULL;
+    char *lua_id = NULL;
     int stacktop = lua_gettop(Luas);
     lua_active++;
-    s = tokenlist_to_cstring(p, 1, &l);
-    ls.s = s;
-    ls.size = (size_t) l;
-    if (ls.size > 0) {
+    /*tex The name goes first because the code stays in the scratch buffer. */
+    if (nameptr > 0) {
+        lua_id = tokenlist_to_cstring(nameptr, 1, NULL);
+    }
+    s = tokenlist_to_tstring(p, 1, &l);
+    if (l > 0) {
         if (nameptr > 0) {
-            lua_id = tokenlist_to_cstring(nameptr, 1, &l);
-            i = Luas_load(Luas, getS, &ls, lua_id);
-            xfree(lua_id);
+            i = load_cached_chunk(Luas, s, (size_t) l, lua_id);
         } else if (nameptr < 0) {
-            lua_id = get_lua_name((nameptr + 65536));
-            if (lua_id != NULL) {
-                i = Luas_load(Luas, getS, &ls, lua_id);
+            /*tex This one belongs to the name registers, so it is not freed. */
+            const char *lua_name = get_lua_name((nameptr + 65536));
+            if (lua_name != NULL) {
+                i = load_cached_chunk(Luas, s, (size_t) l, lua_name);
             } else {
-                i = Luas_load(Luas, getS, &ls, "=[\\directlua]");
+                i = load_cached_chunk(Luas, s, (size_t) l, "=[\\directlua]");
             }
         } else {
-            i = Luas_load(Luas, getS, &ls, "=[\\directlua]");
+            i = load_cached_chunk(Luas, s, (size_t) l, "=[\\directlua]");
         }
-        xfree(s);
         if (i != 0) {
             Luas = luatex_error(Luas, (i == LUA_ERRSYNTAX ? 0 : 1));
         } else {
@@ -368,6 +438,7 @@ void luatokencall(int p, int nameptr)
             }
         }
     }
+    xfree(lua_id);
     lua_settop(Luas,stacktop);
     lua_active--;
 }
@@ -419,6 +490,16 @@ int lua_numeric_field_by_index(lua_State * L, int name_index, int dflt)
     return i;
 }
 
+/*tex Push a \TEX\ string without making an intermediate copy. */
+
+void lua_push_str_number(lua_State * L, int s)
+{
+    char buf[5];
+    size_t l;
+    const char *v = makeclview(s, &l, buf);
+    lua_pushlstring(L, v, l);
+}
+
 unsigned int lua_unsigned_numeric_field_by_index(lua_State * L, int name_index, int dflt)
 {
     register unsigned int i = dflt;
@@ -106,6 +106,7 @@ extern int font_parameters_to_lua(lua_State * L, int f);
 extern int font_to_lua(lua_State * L, int f, int usecache);
 extern int font_from_lua(lua_State * L, int f); /* return is boolean */
 extern int characters_from_lua(lua_State * L, int f); /* return is boolean */
+extern int font_to_packed_lua(lua_State * L, int f); /* pushes three strings */
 
 extern int luaopen_token(lua_State * L);
 extern void tokenlist_to_lua(lua_State * L, int p);
@@ -162,6 +163,8 @@ extern int luastate_bytes;
 extern int callback_count;
 extern int saved_callback_count;
 extern int direct_callback_count;
+extern int direct_cache_hit_count;
+extern int direct_cache_miss_count;
 extern int late_callback_count;
 extern int function_callback_count;
 
@@ -171,6 +174,7 @@ extern const char *engine_name;
 /* luastuff.h */
 
 extern char *startup_filename;
+extern char *font_cache_dir;
 extern int utc_option;
 
 extern char *last_source_name;
@@ -286,6 +290,7 @@ is useless.
 #define lua_roundnumber(a,b)  (int)floor((double)lua_tonumber(a,b)+0.5)
 #define lua_uroundnumber(a,b) (unsigned int)((double)(lua_tonumber(a,b)+0.5))
 extern int lua_numeric_field_by_index(lua_State *, int , int);
+extern void lua_push_str_number(lua_State * L, int s);
 extern unsigned int lua_unsigned_numeric_field_by_index(lua_State *, int , int);
 
 /* Currently we sometimes use numbers and sometimes strings in node properties. We can
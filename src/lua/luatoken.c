@@ -468,10 +468,8 @@ void tokenlist_to_lua(lua_State * L, int p)
 void tokenlist_to_luastring(lua_State * L, int p)
 {
     int l;
-    char *s;
-    s = tokenlist_to_cstring(p, 1, &l);
+    const char *s = tokenlist_to_tstring(p, 1, &l);
     lua_pushlstring(L, s, (size_t) l);
-    free(s);
 }
 
 int tokenlist_from_lua(lua_State * L)
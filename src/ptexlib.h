@@ -318,6 +318,7 @@ char * concat(const char *s1, const char *s2);
 #  include "tex/dumpdata.h"
 #  include "tex/mainbody.h"
 #  include "tex/extensions.h"
+#  include "tex/shipout.h"
 #  include "tex/texnodes.h"
 
 #  include "tex/texmath.h"
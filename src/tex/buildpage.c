@@ -1067,6 +1067,21 @@ void fire_up(halfword c)
         scan_left_brace();
         return;
     }
+    /*tex Perform the default output routine. */
+    if (vlink(page_head) != null) {
+        if (vlink(contrib_head) == null) {
+            contrib_tail = page_tail;
+        } else {
+            couple_nodes(page_tail, vlink(contrib_head));
+        }
+        couple_nodes(contrib_head, vlink(page_head));
+        vlink(page_head) = null;
+        page_tail = page_head;
+    }
+    flush_node_list(page_disc);
+    page_disc = null;
+    ship_out(box(output_box_par));
+    box(output_box_par) = null;
 }
 
 /*tex
@@ -174,6 +174,8 @@ void initialize_commands(void)
     primitive_luatex("exceptionpenalty", assign_int_cmd, int_base + exception_penalty_code, int_base);
     primitive_luatex("fixupboxesmode", assign_int_cmd, int_base + fixup_boxes_code, int_base);
     primitive_luatex("glyphdimensionsmode", assign_int_cmd, int_base + glyph_dimensions_code, int_base);
+    primitive_luatex("internmacrosmode", assign_int_cmd, int_base + intern_macros_code, int_base);
+    primitive_luatex("paragraphcachemode", assign_int_cmd, int_base + paragraph_cache_code, int_base);
 
     /*tex
 
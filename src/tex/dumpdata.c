@@ -96,6 +96,10 @@ void store_fmt_file(void)
     if (callback_id > 0) {
         (void) run_callback(callback_id, "->");
     }
+    flush_interned_token_lists();
+    flush_attribute_states();
+    flush_paragraph_cache();
+    flush_math_memo();
     selector = new_string;
     tprint(" (format=");
     print(job_name);
@@ -515,6 +519,7 @@ boolean load_fmt_file(const char *fmtname)
         /*tex Undump the array info for internal font number |k| */
         undump_font(k);
     }
+    undump_font_instances();
     undump_math_data();
     /*tex Undump the hyphenation tables */
     undump_language_data();
@@ -308,8 +308,10 @@ the |number_regs| \.{\\dimen} registers.
 #  define suppress_primitive_error_code 116
 #  define fixup_boxes_code 117
 #  define glyph_dimensions_code 118
+#  define intern_macros_code 119
+#  define paragraph_cache_code 120
 
-#  define math_option_code 119
+#  define math_option_code 121
 
 #  define mathoption_int_base_code (math_option_code+1)                 /* one reserve */
 #  define mathoption_int_last_code (mathoption_int_base_code+8)
@@ -463,6 +465,7 @@ typedef enum {
     /*
     c_mathoption_umathcode_meaning_code,
     */
+    c_mathoption_memo_code = 1,
 } math_option_codes ;
 
 #  define mathoption_int_par(A) eqtb[mathoption_int_base+(A)].cint
@@ -763,6 +766,7 @@ extern halfword last_cs_name;
 #define copy_lua_input_nodes_par           int_par(copy_lua_input_nodes_code)
 
 #define math_old_par                       mathoption_int_par(c_mathoption_old_code)
+#define math_memo_par                      mathoption_int_par(c_mathoption_memo_code)
 
 /*
 #define math_umathcode_meaning_par         mathoption_int_par(c_mathoption_umathcode_meaning_code)
@@ -801,6 +805,8 @@ extern halfword last_cs_name;
 
 #define fixup_boxes_par                    int_par(fixup_boxes_code)
 #define glyph_dimensions_par               int_par(glyph_dimensions_code)
+#define intern_macros_par                  int_par(intern_macros_code)
+#define paragraph_cache_par                int_par(paragraph_cache_code)
 
 /* */
 
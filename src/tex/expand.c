@@ -43,6 +43,7 @@ with LuaTeX; if not, see <http://www.gnu.org/licenses/>.
 */
 
 static int expand_depth_count = 0;
+int max_expand_depth_count = 0;
 
 /*tex
 
@@ -61,6 +62,41 @@ static int expand_depth_count = 0;
 
 int is_in_csname = 0;
 
+/*tex
+
+    When enabled from \LUA, we keep per control sequence statistics: the number
+    of times it got expanded as a macro, the number of token cells taken while
+    its arguments were collected, and the number of new hash entries made by
+    \.{\csname} while its body was being read. The table is indexed by the
+    control sequence pointer, so we only allocate it on demand. Counting itself
+    is just a few increments.
+
+*/
+
+macro_stat *macro_stats = NULL;
+int csname_new_count = 0;
+
+void set_macro_stats(boolean enable)
+{
+    xfree(macro_stats);
+    if (enable)
+        macro_stats = xcalloc((unsigned) (eqtb_top + 1), sizeof(macro_stat));
+}
+
+/*tex The innermost macro that is being read from, if any. */
+
+static halfword current_macro_cs(void)
+{
+    int i;
+    if (istate == token_list && token_type == macro)
+        return iname;
+    for (i = input_ptr - 1; i >= 0; i--) {
+        if (input_stack[i].state_field == token_list && input_stack[i].index_field == macro)
+            return input_stack[i].name_field;
+    }
+    return null;
+}
+
 void expand(void)
 {
     /*tex token that is being ``expanded after'' */
@@ -80,6 +116,8 @@ void expand(void)
     incr(expand_depth_count);
     if (expand_depth_count >= expand_depth)
         overflow("expansion depth", (unsigned) expand_depth);
+    if (expand_depth_count > max_expand_depth_count)
+        max_expand_depth_count = expand_depth_count;
     cv_backup = cur_val;
     cvl_backup = cur_val_level;
     radix_backup = radix;
@@ -384,34 +422,112 @@ void complain_missing_csname(void)
     back_error();
 }
 
-void manufacture_csname(boolean use)
+/*tex
+
+    The name is collected as \UTF-8 bytes in a private buffer, and hashed as we
+    go, so that no token list has to be built and serialized afterwards. Because
+    expansion can trigger a nested \.{\\csname}, each call appends after the
+    bytes of its caller and gives back its part when done. A lookup that misses
+    in the |use| case (\.{\\begincsname}) or in \.{\\ifcsname} does not allocate
+    anything.
+
+*/
+
+static unsigned char *csname_buffer = NULL;
+static int csname_size = 0;
+static int csname_ptr = 0;
+
+int csname_lookup_count = 0;
+int csname_miss_count = 0;
+
+/*tex This collects up to the first control sequence and returns where we started. */
+
+static int collect_csname(int *h)
 {
-    halfword p, q, r;
-    lstring *ss;
-    r = get_avail();
-    p = r;
-    is_in_csname += 1;
+    int first = csname_ptr;
+    unsigned char *b, *e;
     do {
         get_x_token();
-        if (cur_cs == 0)
-            store_new_token(cur_tok);
+        if (cur_cs == 0) {
+            if (csname_ptr + 4 > csname_size) {
+                csname_size = (csname_size == 0) ? 256 : 2 * csname_size;
+                csname_buffer = xrealloc(csname_buffer, (unsigned) csname_size);
+            }
+            b = csname_buffer + csname_ptr;
+            e = (unsigned char *) uni2string((char *) b, (unsigned) cur_chr);
+            csname_ptr += (int) (e - b);
+            while (b < e) {
+                cs_hash_step(*h, *b);
+                b++;
+            }
+        }
     } while (cur_cs == 0);
+    return first;
+}
+
+/*tex A lookup that never enters a new name, and gives back the bytes. */
+
+static halfword lookup_collected_csname(int first, int h)
+{
+    int l = csname_ptr - first;
+    halfword cs = null_cs;
+    csname_lookup_count++;
+    if (l > 0) {
+        cs = hashed_string_lookup((char *) (csname_buffer + first), (size_t) l, h);
+        if (cs == undefined_control_sequence)
+            csname_miss_count++;
+    }
+    csname_ptr = first;
+    return cs;
+}
+
+/*tex
+
+    This is the part of \.{\\ifcsname} that sets |cur_cs| without entering the
+    name. When |suppress| is set a missing \.{\\endcsname} is skipped silently
+    and |false| is returned.
+
+*/
+
+boolean test_csname(boolean suppress)
+{
+    int h = 0;
+    int first;
+    is_in_csname += 1;
+    first = collect_csname(&h);
+    if (cur_cmd != end_cs_name_cmd) {
+        if (suppress) {
+            do {
+                get_x_token();
+            } while (cur_cmd != end_cs_name_cmd);
+            csname_ptr = first;
+            is_in_csname -= 1;
+            return false;
+        } else {
+            complain_missing_csname();
+        }
+    }
+    cur_cs = lookup_collected_csname(first, h);
+    is_in_csname -= 1;
+    return true;
+}
+
+void manufacture_csname(boolean use)
+{
+    int h = 0;
+    int first, l;
+    is_in_csname += 1;
+    first = collect_csname(&h);
     if (cur_cmd != end_cs_name_cmd) {
         /*tex Complain about missing \.{\\endcsname}. */
         complain_missing_csname();
     }
-    /*tex Look up the characters of list |r| in the hash table, and set |cur_cs|. */
-    ss = tokenlist_to_lstring(r, true);
+    /*tex Look up the characters in the hash table, and set |cur_cs|. */
+    l = csname_ptr - first;
     is_in_csname -= 1;
     if (use) {
-        if (ss->l > 0) {
-            cur_cs = string_lookup((char *) ss->s, ss->l);
-        } else {
-            cur_cs = null_cs;
-        }
+        cur_cs = lookup_collected_csname(first, h);
         last_cs_name = cur_cs ;
-        free_lstring(ss);
-        flush_list(r);
         if (cur_cs == null_cs) {
             /*tex skip */
         } else if (eq_type(cur_cs) == undefined_cs_cmd) {
@@ -421,17 +537,27 @@ void manufacture_csname(boolean use)
             back_input();
         }
     } else {
-        if (ss->l > 0) {
+        csname_lookup_count++;
+        if (l > 0) {
+            int c = cs_count;
             no_new_control_sequence = false;
-            cur_cs = string_lookup((char *) ss->s, ss->l);
+            cur_cs = hashed_string_lookup((char *) (csname_buffer + first), (size_t) l, h);
             no_new_control_sequence = true;
+            if (cs_count > c) {
+                csname_miss_count++;
+                csname_new_count++;
+                if (macro_stats != NULL) {
+                    halfword m = current_macro_cs();
+                    if (m > 0 && m <= eqtb_top)
+                        macro_stats[m].csnames++;
+                }
+            }
         } else {
             /*tex the list is empty */
             cur_cs = null_cs;
         }
+        csname_ptr = first;
         last_cs_name = cur_cs ;
-        free_lstring(ss);
-        flush_list(r);
         if (eq_type(cur_cs) == undefined_cs_cmd) {
             /*tex The |save_stack| might change! */
             eq_define(cur_cs, relax_cmd, too_big_char);
@@ -594,6 +720,55 @@ int long_state;
 
 halfword pstack[9];
 
+/*tex And for shared arguments, the list that they are part of: */
+
+param_span pspan[9];
+
+/*tex
+
+    When an undelimited argument is a group that is read from a macro body, we
+    don't need to copy its tokens: the body is reference counted and never
+    changes, so the argument can share them. This is what happens a lot in
+    macro packages that pass arguments around. Here we look ahead in the body,
+    starting after the left brace at |p|, for the matching right brace. We
+    give up when something could make reading the tokens one by one behave
+    differently: a parameter, a forbidden \.{\par}, an outer macro or an
+    alignment that could see an |&|. The result is the right brace or |null|.
+
+*/
+
+static halfword scan_shared_argument(halfword p)
+{
+    int unbalance = 1;
+    if (align_state <= 0) {
+        return null;
+    }
+    while (p != null) {
+        halfword t = token_info(p);
+        if (t >= cs_token_flag) {
+            if (t == par_token && long_state != long_call_cmd && !suppress_long_error_par) {
+                return null;
+            } else if (t == cs_token_flag + frozen_dont_expand || eq_type(t - cs_token_flag) >= outer_call_cmd) {
+                return null;
+            }
+        } else {
+            switch (token_cmd(t)) {
+                case left_brace_cmd:
+                    unbalance++;
+                    break;
+                case right_brace_cmd:
+                    if (--unbalance == 0)
+                        return p;
+                    break;
+                case out_param_cmd:
+                    return null;
+            }
+        }
+        p = token_link(p);
+    }
+    return null;
+}
+
 /*tex
 
     After parameter scanning is complete, the parameters are moved to the
@@ -642,7 +817,15 @@ void macro_call(void)
     halfword save_warning_index = warning_index;
     /*tex character used in parameter */
     int match_chr = 0;
+    /*tex the macro body token that was read last, if any */
+    halfword b = null;
+    /*tex and the input level it was read at */
+    int b_level = 0;
+    /*tex token cells in use upon entry, when we collect statistics */
+    int d = dyn_used;
     warning_index = cur_cs;
+    if (macro_stats != NULL && cur_cs <= eqtb_top)
+        macro_stats[cur_cs].calls++;
     ref_count = cur_chr;
     r = token_link(ref_count);
     if (tracing_macros_par > 0) {
@@ -704,8 +887,13 @@ void macro_call(void)
 
             */
           CONTINUE:
-            /*tex Set |cur_tok| to the next token of input: */
+            /*tex Set |cur_tok| to the next token of input, and note where it came from. */
+            b = (istate == token_list && token_type == macro) ? iloc : null;
+            b_level = input_ptr;
             get_token();
+            if (b != null && !(input_ptr == b_level && istate == token_list && iloc == token_link(b))) {
+                b = null;
+            }
             if (cur_tok == token_info(r)) {
                 /*tex
 
@@ -804,6 +992,26 @@ void macro_call(void)
                     }
             if (cur_tok < right_brace_limit) {
                 if (cur_tok < left_brace_limit) {
+                    if (b != null && s == r && m == 0 && token_info(r) >= match_token && token_info(r) <= end_match_token) {
+                        /*tex An undelimited argument from a macro body, maybe we can share it. */
+                        halfword e = scan_shared_argument(token_link(b));
+                        if (e != null) {
+                            if (e == token_link(b)) {
+                                /*tex An empty group. */
+                                pstack[n] = null;
+                                pspan[n].ref = null;
+                            } else {
+                                pstack[n] = token_link(b);
+                                pspan[n].ref = istart;
+                                pspan[n].end = e;
+                                add_token_ref(istart);
+                            }
+                            iloc = token_link(e);
+                            /*tex The right brace: */
+                            decr(align_state);
+                            goto SHARED;
+                        }
+                    }
                     /*tex Contribute an entire group to the current parameter. */
                     unbalance = 1;
                     while (1) {
@@ -886,6 +1094,8 @@ void macro_call(void)
                 } else {
                     pstack[n] = token_link(temp_token_head);
                 }
+                pspan[n].ref = null;
+              SHARED:
                 incr(n);
                 if (tracing_macros_par > 0) {
                     begin_diagnostic();
@@ -894,7 +1104,11 @@ void macro_call(void)
                     print(match_chr);
                     print_int(n);
                     tprint("<-");
-                    show_token_list(pstack[n - 1], null, 1000);
+                    if (pspan[n - 1].ref != null) {
+                        show_token_span(pstack[n - 1], pspan[n - 1].end, null, 1000);
+                    } else {
+                        show_token_list(pstack[n - 1], null, 1000);
+                    }
                     end_diagnostic(false);
                 }
             }
@@ -914,7 +1128,7 @@ void macro_call(void)
         to itself will not require unbounded stack space.
 
     */
-    while ((istate == token_list) && (iloc == null) && (token_type != v_template)) {
+    while ((istate == token_list) && token_list_done() && (token_type != v_template)) {
         /*tex Conserve stack space. */
         end_token_list();
     }
@@ -927,8 +1141,10 @@ void macro_call(void)
             if (max_param_stack > param_size)
                 overflow("parameter stack size", (unsigned) param_size);
         }
-        for (m = 0; m <= n - 1; m++)
+        for (m = 0; m <= n - 1; m++) {
             param_stack[param_ptr + m] = pstack[m];
+            param_span_stack[param_ptr + m] = pspan[m];
+        }
         param_ptr = param_ptr + n;
     }
     goto EXIT;
@@ -952,10 +1168,18 @@ void macro_call(void)
         back_error();
     }
     pstack[n] = token_link(temp_token_head);
+    pspan[n].ref = null;
     align_state = align_state - unbalance;
-    for (m = 0; m <= n; m++)
-        flush_list(pstack[m]);
+    for (m = 0; m <= n; m++) {
+        if (pspan[m].ref != null) {
+            delete_token_ref(pspan[m].ref);
+        } else {
+            flush_list(pstack[m]);
+        }
+    }
   EXIT:
+    if (macro_stats != NULL && warning_index <= eqtb_top && dyn_used > d)
+        macro_stats[warning_index].tokens += dyn_used - d;
     scanner_status = save_scanner_status;
     warning_index = save_warning_index;
 }
@@ -22,9 +22,24 @@
 #  define EXPAND_H
 
 extern boolean is_in_csname;
+
+typedef struct macro_stat {
+    int calls;
+    int tokens;
+    int csnames;
+} macro_stat;
+
+extern macro_stat *macro_stats;
+extern int csname_new_count;
+extern int csname_lookup_count;
+extern int csname_miss_count;
+extern int max_expand_depth_count;
+extern void set_macro_stats(boolean enable);
+
 extern void expand(void);
 extern void complain_missing_csname(void);
 extern void manufacture_csname(boolean use);
+extern boolean test_csname(boolean suppress);
 extern void inject_last_tested_cs(void);
 extern void insert_relax(void);
 extern void get_x_token(void);
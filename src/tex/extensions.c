@@ -340,21 +340,25 @@ void write_out(halfword p)
     } else {
         tprint_nl("");
     }
-    s = tokenlist_to_lstring(def_ref, false);
-    if (selector < no_print) {
-        /*tex selector is a file */
-        callback_id = callback_defined(process_output_buffer_callback);
-        if (callback_id > 0) {
-            /*tex fix up the output buffer using callbacks */
-            lua_retval = run_callback(callback_id, "L->L", s, &ss);
-            if ((lua_retval == true) && (ss != NULL)) {
-                free_lstring(s);
-                s = ss;
-            }
+    callback_id = (selector < no_print) ? callback_defined(process_output_buffer_callback) : 0;
+    if (callback_id > 0) {
+        /*tex fix up the output buffer using callbacks */
+        s = tokenlist_to_lstring(def_ref, false);
+        lua_retval = run_callback(callback_id, "L->L", s, &ss);
+        if ((lua_retval == true) && (ss != NULL)) {
+            free_lstring(s);
+            s = ss;
         }
+        lprint(s);
+        free_lstring(s);
+    } else {
+        /*tex Nothing can come in between, so we print straight from the scratch buffer. */
+        int l;
+        lstring t;
+        t.s = (unsigned char *) tokenlist_to_tstring(def_ref, false, &l);
+        t.l = (size_t) l;
+        lprint(&t);
     }
-    lprint(s);
-    free_lstring(s);
     print_ln();
     flush_list(def_ref);
     selector = old_setting;
@@ -120,6 +120,10 @@ maintained with convention (2), and it grows at a different rate from the others
 
 pointer *param_stack = NULL;
 
+/*tex The shared arguments, see |macro_call|: */
+
+param_span *param_span_stack = NULL;
+
 /*tex First unused entry in |param_stack|: */
 
 int param_ptr = 0;
@@ -419,7 +423,9 @@ void show_context(void)
                     print_token_list_type(token_type);
 
                     begin_pseudoprint();
-                    if (token_type < macro) {
+                    if (token_type == parameter && param_end != null) {
+                        show_token_span(istart, param_end, iloc, 100000);
+                    } else if (token_type < macro) {
                         show_token_list(istart, iloc, 100000);
                     } else {
                         /*tex Avoid reference count. */
@@ -565,7 +571,11 @@ void end_token_list(void)
                 /*tex Parameters must be flushed: */
                 while (param_ptr > param_start) {
                     decr(param_ptr);
-                    flush_list(param_stack[param_ptr]);
+                    if (param_span_stack[param_ptr].ref != null) {
+                        delete_token_ref(param_span_stack[param_ptr].ref);
+                    } else {
+                        flush_list(param_stack[param_ptr]);
+                    }
                 }
             }
         }
@@ -595,7 +605,7 @@ void back_input(void)
 {
     /*tex A token list of length one: */
     halfword p;
-    while ((istate == token_list) && (iloc == null) && (token_type != v_template)) {
+    while ((istate == token_list) && token_list_done() && (token_type != v_template)) {
         /*tex Conserve stack space. */
         end_token_list();
     }
@@ -286,6 +286,11 @@ corresponding token types must precede |write_text|.
 #  define token_list 0          /* |state| code when scanning a token list */
 #  define token_type iindex     /* type of current token list */
 #  define param_start ilimit    /* base of macro parameters in |param_stack| */
+#  define param_end ilimit      /* end of a shared argument, see |macro_call| */
+
+/* a token list is exhausted at its end, or at the end of a shared argument */
+
+#  define token_list_done() ((iloc == null) || (token_type == parameter && iloc == param_end))
 
 
 typedef enum {
@@ -310,6 +315,20 @@ typedef enum {
 } token_types;
 
 extern pointer *param_stack;
+
+/*
+  An argument that is a group in a macro body can share the tokens of that
+  body instead of being a copy. Then |ref| is the (reference counted) body
+  and |end| the token after the argument; for copied arguments |ref| is
+  |null|.
+*/
+
+typedef struct param_span {
+    halfword ref;
+    halfword end;
+} param_span;
+
+extern param_span *param_span_stack;
 extern int param_ptr;
 extern int max_param_stack;
 
@@ -75,6 +75,161 @@ with LuaTeX; if not, see <http://www.gnu.org/licenses/>.
 
 halfword just_box;
 
+/*tex
+
+    When \.{\\paragraphcachemode} is positive the lines that result from breaking
+    a paragraph are remembered, keyed by a structural hash of the hlist and of
+    everything else that influences the result: the line breaking parameters,
+    the interline glue and the state of the enclosing vertical list. A paragraph
+    that comes by again is then not broken but gets a copy of the lines. A hit
+    is only taken when a copy of the hlist that was broken is the same as the
+    current one. The cache is not used when tracing paragraphs or when lines or
+    the vertical list are filtered by \LUA, and over- and underfull box
+    messages are only given the first time.
+
+*/
+
+#define paragraph_cache_size 256
+
+typedef struct paragraph_cache_entry {
+    uint64_t key;
+    halfword hlist;
+    halfword lines;
+    halfword last_line;
+    int prev_graf;
+    scaled prev_depth;
+} paragraph_cache_entry;
+
+static paragraph_cache_entry paragraph_cache[paragraph_cache_size] = { { 0, null, null, null, 0, 0 } };
+
+int paragraph_cache_hits = 0;
+
+#define paragraph_hash_step(h,v) h = ((h) ^ (uint64_t) (unsigned) (v)) * 0x100000001b3ULL
+
+static uint64_t paragraph_hash_shape(uint64_t h, halfword p)
+{
+    if (p != null) {
+        int i;
+        for (i = 1; i < subtype(p); i++) {
+            paragraph_hash_step(h, varmem[p + i].cint);
+        }
+    }
+    paragraph_hash_step(h, 0xFFFF);
+    return h;
+}
+
+static boolean paragraph_key(boolean d, int paragraph_dir, uint64_t *key)
+{
+    int complete, c;
+    uint64_t h = hash_node_list(vlink(temp_head), &complete);
+    if (! complete) {
+        return false;
+    }
+    paragraph_hash_step(h, d);
+    paragraph_hash_step(h, paragraph_dir);
+    paragraph_hash_step(h, pretolerance_par);
+    paragraph_hash_step(h, tolerance_par);
+    paragraph_hash_step(h, emergency_stretch_par);
+    paragraph_hash_step(h, looseness_par);
+    paragraph_hash_step(h, adjust_spacing_par);
+    paragraph_hash_step(h, adj_demerits_par);
+    paragraph_hash_step(h, protrude_chars_par);
+    paragraph_hash_step(h, line_penalty_par);
+    paragraph_hash_step(h, last_line_fit_par);
+    paragraph_hash_step(h, double_hyphen_demerits_par);
+    paragraph_hash_step(h, final_hyphen_demerits_par);
+    paragraph_hash_step(h, hang_indent_par);
+    paragraph_hash_step(h, hsize_par);
+    paragraph_hash_step(h, hang_after_par);
+    paragraph_hash_step(h, inter_line_penalty_par);
+    paragraph_hash_step(h, club_penalty_par);
+    paragraph_hash_step(h, (d ? display_widow_penalty_par : widow_penalty_par));
+    paragraph_hash_step(h, broken_penalty_par);
+    paragraph_hash_step(h, line_skip_limit_par);
+    paragraph_hash_step(h, cur_list.pg_field);
+    paragraph_hash_step(h, cur_list.prev_depth_field);
+    /*tex The glue and penalties that get inserted carry the current attributes. */
+    for (c = 0; c <= max_used_attr; c++) {
+        if (attribute(c) > UNUSED_ATTRIBUTE) {
+            paragraph_hash_step(h, c);
+            paragraph_hash_step(h, attribute(c));
+        }
+    }
+    h = paragraph_hash_shape(h, par_shape_par_ptr);
+    h = paragraph_hash_shape(h, inter_line_penalties_par_ptr);
+    h = paragraph_hash_shape(h, club_penalties_par_ptr);
+    h = paragraph_hash_shape(h, (d ? display_widow_penalties_par_ptr : widow_penalties_par_ptr));
+    h = hash_node_list(left_skip_par, &c) ^ (h * 0x100000001b3ULL);
+    h = hash_node_list(right_skip_par, &c) ^ (h * 0x100000001b3ULL);
+    h = hash_node_list(baseline_skip_par, &c) ^ (h * 0x100000001b3ULL);
+    h = hash_node_list(glue_par(line_skip_code), &c) ^ (h * 0x100000001b3ULL);
+    /*tex Zero marks an empty slot. */
+    *key = h == 0 ? 1 : h;
+    return true;
+}
+
+static boolean fetch_cached_paragraph(uint64_t key)
+{
+    paragraph_cache_entry *e = &paragraph_cache[key % paragraph_cache_size];
+    halfword p, q;
+    if (e->key != key || e->lines == null || ! same_node_list(e->hlist, vlink(temp_head))) {
+        return false;
+    }
+    q = copy_node_list(e->lines);
+    couple_nodes(cur_list.tail_field, q);
+    /*tex The last line need not be the last box, think of a \.{\vadjust}. */
+    just_box = null;
+    p = e->lines;
+    while (q != null) {
+        if (p == e->last_line) {
+            just_box = q;
+        }
+        cur_list.tail_field = q;
+        p = vlink(p);
+        q = vlink(q);
+    }
+    cur_list.pg_field = e->prev_graf;
+    cur_list.prev_depth_field = e->prev_depth;
+    paragraph_cache_hits++;
+    return true;
+}
+
+static void store_cached_paragraph(uint64_t key, halfword hlist, halfword start_of_par)
+{
+    paragraph_cache_entry *e = &paragraph_cache[key % paragraph_cache_size];
+    halfword p, q;
+    flush_node_list(e->hlist);
+    flush_node_list(e->lines);
+    e->key = key;
+    e->hlist = hlist;
+    e->lines = copy_node_list(vlink(start_of_par));
+    e->last_line = null;
+    p = vlink(start_of_par);
+    q = e->lines;
+    while (p != null) {
+        if (p == just_box) {
+            e->last_line = q;
+        }
+        p = vlink(p);
+        q = vlink(q);
+    }
+    e->prev_graf = cur_list.pg_field;
+    e->prev_depth = cur_list.prev_depth_field;
+}
+
+void flush_paragraph_cache(void)
+{
+    int i;
+    for (i = 0; i < paragraph_cache_size; i++) {
+        flush_node_list(paragraph_cache[i].hlist);
+        flush_node_list(paragraph_cache[i].lines);
+        paragraph_cache[i].key = 0;
+        paragraph_cache[i].hlist = null;
+        paragraph_cache[i].lines = null;
+        paragraph_cache[i].last_line = null;
+    }
+}
+
 /*tex
 
     In it's complete form, |line_break| is a rather lengthy procedure---sort of a
@@ -102,6 +257,8 @@ void line_break(boolean d, int line_break_context)
     halfword final_par_glue;
     halfword start_of_par;
     int callback_id;
+    uint64_t key = 0;
+    boolean cached = false;
     /*tex this is for over/underfull box messages */
     pack_begin_line = cur_list.ml_field;
     alink(temp_head) = null;
@@ -163,35 +320,49 @@ void line_break(boolean d, int line_break_context)
         } else {
             confusion("weird par dir");
         }
-        ext_do_line_break(
-            paragraph_dir,
-            pretolerance_par,
-            tracing_paragraphs_par,
-            tolerance_par,
-            emergency_stretch_par,
-            looseness_par,
-            adjust_spacing_par,
-            par_shape_par_ptr,
-            adj_demerits_par,
-            protrude_chars_par,
-            line_penalty_par,
-            last_line_fit_par,
-            double_hyphen_demerits_par,
-            final_hyphen_demerits_par,
-            hang_indent_par,
-            hsize_par,
-            hang_after_par,
-            left_skip_par,
-            right_skip_par,
-            inter_line_penalties_par_ptr,
-            inter_line_penalty_par,
-            club_penalty_par,
-            club_penalties_par_ptr,
-            (d ? display_widow_penalties_par_ptr : widow_penalties_par_ptr),
-            (d ? display_widow_penalty_par : widow_penalty_par),
-            broken_penalty_par,
-            final_par_glue
-        );
+        if (paragraph_cache_par > 0 && tracing_paragraphs_par <= 0
+                && callback_defined(hpack_filter_callback) == 0
+                && callback_defined(append_to_vlist_filter_callback) == 0) {
+            cached = paragraph_key(d, paragraph_dir, &key);
+        }
+        if (cached && fetch_cached_paragraph(key)) {
+            flush_node_list(vlink(temp_head));
+            vlink(temp_head) = null;
+        } else {
+            halfword hlist = cached ? copy_node_list(vlink(temp_head)) : null;
+            ext_do_line_break(
+                paragraph_dir,
+                pretolerance_par,
+                tracing_paragraphs_par,
+                tolerance_par,
+                emergency_stretch_par,
+                looseness_par,
+                adjust_spacing_par,
+                par_shape_par_ptr,
+                adj_demerits_par,
+                protrude_chars_par,
+                line_penalty_par,
+                last_line_fit_par,
+                double_hyphen_demerits_par,
+                final_hyphen_demerits_par,
+                hang_indent_par,
+                hsize_par,
+                hang_after_par,
+                left_skip_par,
+                right_skip_par,
+                inter_line_penalties_par_ptr,
+                inter_line_penalty_par,
+                club_penalty_par,
+                club_penalties_par_ptr,
+                (d ? display_widow_penalties_par_ptr : widow_penalties_par_ptr),
+                (d ? display_widow_penalty_par : widow_penalty_par),
+                broken_penalty_par,
+                final_par_glue
+            );
+            if (cached) {
+                store_cached_paragraph(key, hlist, start_of_par);
+            }
+        }
     }
     lua_node_filter(post_linebreak_filter_callback, line_break_context, start_of_par, addressof(cur_list.tail_field));
     pack_begin_line = 0;
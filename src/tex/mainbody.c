@@ -411,6 +411,7 @@ int main_initialize(void)
     source_filename_stack = xmallocarray(str_number, (unsigned) max_in_open);
     full_source_filename_stack = xmallocarray(char *, (unsigned) max_in_open);
     param_stack = xmallocarray(halfword, (unsigned) param_size);
+    param_span_stack = xmallocarray(param_span, (unsigned) param_size);
     /*tex
         Only in ini mode:
     */
@@ -574,6 +575,7 @@ void close_files_and_terminate(void)
     int callback_id;
     callback_id = callback_defined(stop_run_callback);
     finalize_write_files();
+    finish_shipout();
     if (tracing_stats_par > 0) {
         if (callback_id == 0) {
             /*tex
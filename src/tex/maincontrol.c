@@ -120,9 +120,23 @@ static void run_char_num (void) {
     tail_append(new_char(cur_font_par, cur_chr));
 }
 
+/*tex
+
+    When not tracing, the rest of a run of letters and other characters in the
+    current line is appended here instead of going around the main loop for
+    each of them.
+
+*/
+
 static void run_char (void) {
     adjust_space_factor();
     tail_append(new_char(cur_font_par, cur_chr));
+    if (tracing_commands_par <= 0) {
+        while (interrupt == 0 && get_next_char()) {
+            adjust_space_factor();
+            tail_append(new_char(cur_font_par, cur_chr));
+        }
+    }
 }
 
 static void run_node (void) {
@@ -698,6 +712,8 @@ static void run_option(void) {
         case math_option_code:
             if (scan_keyword("old")) {
                 mathoption_set_int(c_mathoption_old_code);
+            } else if (scan_keyword("memo")) {
+                mathoption_set_int(c_mathoption_memo_code);
             /*
             } else if (scan_keyword("umathcodemeaning")) {
                 mathoption_set_int(c_mathoption_umathcode_meaning_code);
@@ -1731,8 +1747,7 @@ void box_end(int box_context)
             if (box_context != ship_out_flag) {
                 normal_error("scanner","shipout expected");
             }
-	    // TODO(mvlasak): what is this?
-            //ship_out(static_pdf, cur_box, SHIPPING_PAGE);
+            ship_out(cur_box);
         }
     }
 }
@@ -2686,6 +2701,8 @@ void prefixed_command(void)
                 set_token_link(q, token_link(def_ref));
                 set_token_link(def_ref, q);
             }
+            if (intern_macros_par > 0)
+                def_ref = intern_token_list(def_ref);
             define(p, call_cmd + (a % 4), def_ref);
             break;
         case let_cmd:
@@ -1373,12 +1373,12 @@ pointer make_extensible(internal_font_number fnt, halfword chr, scaled v, scaled
         with_extenders++;
         for (cur = ext; cur != NULL; cur = cur->next) {
             if (cur->extender == 0) {
-                c = cur->start_overlap;
+                c = font_scaled(fnt, cur->start_overlap);
                 if (min_overlap < c)
                     c = min_overlap;
                 if (prev_overlap < c)
                     c = prev_overlap;
-                a = cur->advance;
+                a = font_scaled(fnt, cur->advance);
                 if (a == 0) {
                     /*tex for tfm fonts */
                     if (horizontal) {
@@ -1391,16 +1391,16 @@ pointer make_extensible(internal_font_number fnt, halfword chr, scaled v, scaled
                     }
                 }
                 b_max += a - c;
-                prev_overlap = cur->end_overlap;
+                prev_overlap = font_scaled(fnt, cur->end_overlap);
             } else {
                 i = with_extenders;
                 while (i > 0) {
-                    c = cur->start_overlap;
+                    c = font_scaled(fnt, cur->start_overlap);
                     if (min_overlap < c)
                         c = min_overlap;
                     if (prev_overlap < c)
                         c = prev_overlap;
-                    a = cur->advance;
+                    a = font_scaled(fnt, cur->advance);
                     if (a == 0) {
                         /*tex for tfm fonts */
                         if (horizontal) {
@@ -1413,7 +1413,7 @@ pointer make_extensible(internal_font_number fnt, halfword chr, scaled v, scaled
                         }
                     }
                     b_max += a - c;
-                    prev_overlap = cur->end_overlap;
+                    prev_overlap = font_scaled(fnt, cur->end_overlap);
                     i--;
                 }
             }
@@ -1430,7 +1430,7 @@ pointer make_extensible(internal_font_number fnt, halfword chr, scaled v, scaled
     s_max = 0;
     for (cur = ext; cur != NULL; cur = cur->next) {
         if (cur->extender == 0) {
-            c = cur->start_overlap;
+            c = font_scaled(fnt, cur->start_overlap);
             if (prev_overlap < c)
                 c = prev_overlap;
             d = c;
@@ -1442,12 +1442,12 @@ pointer make_extensible(internal_font_number fnt, halfword chr, scaled v, scaled
                 b_max -= d;
             }
             b_max += stack_into_box(b, fnt, cur->glyph);
-            prev_overlap = cur->end_overlap;
+            prev_overlap = font_scaled(fnt, cur->end_overlap);
             i--;
         } else {
             i = with_extenders;
             while (i > 0) {
-                c = cur->start_overlap;
+                c = font_scaled(fnt, cur->start_overlap);
                 if (prev_overlap < c)
                     c = prev_overlap;
                 d = c;
@@ -1459,7 +1459,7 @@ pointer make_extensible(internal_font_number fnt, halfword chr, scaled v, scaled
                     b_max -= d;
                 }
                 b_max += stack_into_box(b, fnt, cur->glyph);
-                prev_overlap = cur->end_overlap;
+                prev_overlap = font_scaled(fnt, cur->end_overlap);
                 i--;
             }
         }
@@ -1853,6 +1853,199 @@ static void math_kern(pointer p, scaled m)
     }
 }
 
+/*tex
+
+    Documents often have the same small formulas over and over again. When
+    \.{\\mathoption memo 1} is set, the hlists of formulas made of simple noads
+    with characters as nucleus and scripts are remembered, and a copy is
+    returned when the same list shows up again. Besides the noads (including
+    their attribute lists) the key has the style, the penalty flag, the
+    generation of the family fonts and math parameters and the other
+    parameters that |mlist_to_hlist| consults. The remembered noads keep their
+    attribute lists alive, so comparing these by pointer is safe.
+
+*/
+
+#define math_memo_size      1024
+#define math_memo_max_noads   16
+#define math_memo_glues     (thick_mu_skip_code + 1)
+#define math_memo_env_size  (23 + 5 * math_memo_glues)
+
+typedef struct math_memo_entry {
+    unsigned hash;
+    int style;
+    int penalties;
+    int env[math_memo_env_size];
+    halfword mlist;
+    halfword hlist;
+} math_memo_entry;
+
+static math_memo_entry *math_memo = NULL;
+
+static void math_memo_environment(int *env)
+{
+    int i = 0, j;
+    env[i++] = math_data_generation;
+    env[i++] = math_old_par;
+    env[i++] = bin_op_penalty_par;
+    env[i++] = rel_penalty_par;
+    env[i++] = pre_bin_op_penalty_par;
+    env[i++] = pre_rel_penalty_par;
+    env[i++] = delimiter_factor_par;
+    env[i++] = delimiter_shortfall_par;
+    env[i++] = null_delimiter_space_par;
+    env[i++] = script_space_par;
+    env[i++] = disable_kern_par;
+    env[i++] = disable_lig_par;
+    env[i++] = math_direction_par;
+    env[i++] = math_delimiters_mode_par;
+    env[i++] = math_italics_mode_par;
+    env[i++] = math_nolimits_mode_par;
+    env[i++] = math_penalties_mode_par;
+    env[i++] = math_rule_thickness_mode_par;
+    env[i++] = math_rules_fam_par;
+    env[i++] = math_rules_mode_par;
+    env[i++] = math_script_box_mode_par;
+    env[i++] = math_script_char_mode_par;
+    env[i++] = math_scripts_mode_par;
+    /*tex The spacing can refer to these glue registers. */
+    for (j = 0; j < math_memo_glues; j++) {
+        halfword g = glue_par(j);
+        if (g == null) {
+            env[i++] = 0; env[i++] = 0; env[i++] = 0; env[i++] = 0; env[i++] = 0;
+        } else {
+            env[i++] = width(g);
+            env[i++] = stretch(g);
+            env[i++] = shrink(g);
+            env[i++] = stretch_order(g);
+            env[i++] = shrink_order(g);
+        }
+    }
+}
+
+#define math_memo_mix(h,v) h = (h ^ (unsigned) (v)) * 16777619U
+
+static boolean math_memo_kernel(halfword p, unsigned *h)
+{
+    if (p == null) {
+        math_memo_mix(*h, 0);
+        return true;
+    } else if (type(p) == math_char_node) {
+        math_memo_mix(*h, subtype(p) + 1);
+        math_memo_mix(*h, math_fam(p));
+        math_memo_mix(*h, math_character(p));
+        math_memo_mix(*h, node_attr(p));
+        return true;
+    } else {
+        return false;
+    }
+}
+
+/*tex We return zero when the list is not one that we remember. */
+
+static unsigned math_memo_hash(halfword p)
+{
+    unsigned h = 2166136261U;
+    int n = 0;
+    while (p != null) {
+        int i;
+        if (type(p) != simple_noad || ++n > math_memo_max_noads)
+            return 0;
+        math_memo_mix(h, subtype(p));
+        math_memo_mix(h, node_attr(p));
+        if (nucleus(p) == null)
+            return 0;
+        if (! (math_memo_kernel(nucleus(p), &h) && math_memo_kernel(supscr(p), &h) && math_memo_kernel(subscr(p), &h)))
+            return 0;
+        for (i = 4; i < noad_size; i++) {
+            math_memo_mix(h, vinfo(p + i));
+            math_memo_mix(h, vlink(p + i));
+        }
+        p = vlink(p);
+    }
+    return (h == 0) ? 1 : h;
+}
+
+static boolean same_math_memo_kernel(halfword p, halfword q)
+{
+    if (p == null || q == null)
+        return (p == q);
+    return (subtype(p) == subtype(q) && math_fam(p) == math_fam(q)
+        && math_character(p) == math_character(q) && node_attr(p) == node_attr(q));
+}
+
+static boolean same_math_memo_list(halfword p, halfword q)
+{
+    while (p != null && q != null) {
+        int i;
+        if (subtype(p) != subtype(q) || node_attr(p) != node_attr(q))
+            return false;
+        if (! (same_math_memo_kernel(nucleus(p), nucleus(q))
+            && same_math_memo_kernel(supscr(p), supscr(q))
+            && same_math_memo_kernel(subscr(p), subscr(q))))
+            return false;
+        for (i = 4; i < noad_size; i++) {
+            if (vinfo(p + i) != vinfo(q + i) || vlink(p + i) != vlink(q + i))
+                return false;
+        }
+        p = vlink(p);
+        q = vlink(q);
+    }
+    return (p == q);
+}
+
+static void memo_mlist_to_hlist(halfword p, boolean penalties, int mstyle)
+{
+    int env[math_memo_env_size];
+    unsigned h = math_memo_hash(p);
+    math_memo_entry *m;
+    if (h == 0) {
+        mlist_to_hlist(p, penalties, mstyle);
+        return;
+    }
+    if (math_memo == NULL) {
+        math_memo = xcalloc(math_memo_size, sizeof(math_memo_entry));
+    }
+    math_memo_environment(env);
+    m = &math_memo[h % math_memo_size];
+    if (m->hash == h && m->style == mstyle && m->penalties == penalties
+        && memcmp(m->env, env, sizeof(env)) == 0 && same_math_memo_list(m->mlist, p)) {
+        flush_node_list(p);
+        vlink(temp_head) = copy_node_list(m->hlist);
+        return;
+    }
+    /*tex A miss, so we (re)place the entry. */
+    if (m->hash != 0) {
+        flush_node_list(m->mlist);
+        flush_node_list(m->hlist);
+    }
+    m->hash = h;
+    m->style = mstyle;
+    m->penalties = penalties;
+    memcpy(m->env, env, sizeof(env));
+    m->mlist = copy_node_list(p);
+    mlist_to_hlist(p, penalties, mstyle);
+    m->hlist = copy_node_list(vlink(temp_head));
+}
+
+/*tex The remembered lists are not dumped into a format. */
+
+void flush_math_memo(void)
+{
+    int i;
+    if (math_memo == NULL) {
+        return;
+    }
+    for (i = 0; i < math_memo_size; i++) {
+        if (math_memo[i].hash != 0) {
+            flush_node_list(math_memo[i].mlist);
+            flush_node_list(math_memo[i].hlist);
+        }
+    }
+    free(math_memo);
+    math_memo = NULL;
+}
+
 void run_mlist_to_hlist(halfword p, boolean penalties, int mstyle)
 {
     int callback_id;
@@ -1884,7 +2077,11 @@ void run_mlist_to_hlist(halfword p, boolean penalties, int mstyle)
         vlink(temp_head) = a;
         lua_settop(Luas, sfix);
     } else if (callback_id == 0) {
-        mlist_to_hlist(p, penalties, mstyle);
+        if (math_memo_par > 0) {
+            memo_mlist_to_hlist(p, penalties, mstyle);
+        } else {
+            mlist_to_hlist(p, penalties, mstyle);
+        }
     } else {
         vlink(temp_head) = null;
     }
@@ -3534,11 +3731,11 @@ static scaled math_kern_at(internal_font_number f, int c, int side, int v)
         confusion("math_kern_at");
         kerns_heights = NULL;
     }
-    if (v < kerns_heights[0])
-        return kerns_heights[1];
+    if (v < font_scaled(f, kerns_heights[0]))
+        return font_scaled(f, kerns_heights[1]);
     for (k = 0; k < numkerns; k++) {
-        h = kerns_heights[(k * 2)];
-        kern = kerns_heights[(k * 2) + 1];
+        h = font_scaled(f, kerns_heights[(k * 2)]);
+        kern = font_scaled(f, kerns_heights[(k * 2) + 1]);
         if (h > v) {
             return kern;
         }
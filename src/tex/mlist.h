@@ -31,6 +31,7 @@ extern halfword del_shift;
 
 extern void run_mlist_to_hlist(halfword, boolean, int);
 extern void mlist_to_hlist(halfword, boolean, int);
+extern void flush_math_memo(void);
 extern void fixup_math_parameters(int fam_id, int size_id, int f, int lvl);
 
 extern scaled get_math_quad_style(int a);
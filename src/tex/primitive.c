@@ -546,11 +546,20 @@ This one is based on a C string.
 
 pointer string_lookup(const char *s, size_t l)
 {
-    /*tex The hash code: */
-    int h;
+    return hashed_string_lookup(s, l, compute_hash(s, (unsigned) l, hash_prime));
+}
+
+/*tex
+
+When the hash code |h| has already been computed, for instance by |cs_hash_step|
+while the characters were collected, we can skip that step.
+
+*/
+
+pointer hashed_string_lookup(const char *s, size_t l, int h)
+{
     /*tex The index in |hash| array: */
     pointer p;
-    h = compute_hash(s, (unsigned) l, hash_prime);
     /*tex We start searching here. Note that |0<=h<hash_prime|: */
     p = h + hash_base;
     while (1) {
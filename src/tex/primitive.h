@@ -45,6 +45,14 @@ extern halfword hash_high;      /* pointer to next high hash location */
 extern boolean no_new_control_sequence; /* are new identifiers legal? */
 extern int cs_count;            /* total number of known identifiers */
 
+/* one step of the hash function, so that callers can hash while they collect a name */
+
+#  define cs_hash_step(h,c) do {          \
+    h = h + h + (unsigned char) (c);      \
+    while (h >= hash_prime)               \
+        h = h - hash_prime;               \
+} while (0)
+
 #  define cs_next(a) hash[(a)].lhfield  /* link for coalesced lists */
 #  define cs_text(a) hash[(a)].rh
                                 /* string number for control sequence name */
@@ -84,6 +92,7 @@ extern void primitive_def(const char *s, size_t l, quarterword c, halfword o);
 extern void print_cmd_chr(quarterword cmd, halfword chr_code);
 
 extern pointer string_lookup(const char *s, size_t l);
+extern pointer hashed_string_lookup(const char *s, size_t l, int h);
 extern pointer id_lookup(int j, int l);
 
 #endif                          /* LUATEX_PRIMITIVE_H */
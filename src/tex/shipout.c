@@ -0,0 +1,834 @@
+/*
+
+This file is part of LuaTeX.
+
+LuaTeX is free software; you can redistribute it and/or modify it under the terms
+of the GNU General Public License as published by the Free Software Foundation;
+either version 2 of the License, or (at your option) any later version.
+
+LuaTeX is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+LuaTeX; if not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ptexlib.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+/*tex
+
+    There is no \PDF\ backend in this engine. Instead, every page that is shipped
+    out is serialized into a compact binary stream, the file \.{\\jobname.mmo},
+    that can be turned into \PDF\ or \SVG\ by a separate program. A page is
+    written as soon as it is complete and its nodes are freed right away, so
+    pages never pile up in node memory.
+
+    All numbers are four byte little endian integers, dimensions are in scaled
+    points, and the vertical coordinate grows downwards from the top left corner
+    of the page box. The stream starts with the magic \.{MMOB} and the version
+    number, and then has one group of records per page:
+
+    \startitemize
+    \item |D| font, size, design size, and then the name and the file name,
+          each as length and |length| bytes; this comes before the first
+          glyph run in that font
+    \item |P| page number, width, height, depth
+    \item |G| font, baseline, count, and then |count| times horizontal position
+          and character
+    \item |R| left, top, width, height
+    \item |S| kind, left, baseline, identifier, length, and |length| bytes
+    \item |E| the end of the page
+    \stopitemize
+
+    A font identifier is only meaningful within one stream, the |D| record
+    says what it stands for, much like a \DVI\ font definition. A file name
+    that is not known is written with length zero.
+
+    A final |F| record carries the number of pages, so that a consumer can tell
+    a complete file from one that is still being written.
+
+*/
+
+int shipout_bytes = 0;
+
+static FILE *shipout_file = NULL;
+static char *shipout_name = NULL;
+
+static unsigned char *shipout_buffer = NULL;
+static size_t shipout_size = 0;
+static size_t shipout_ptr = 0;
+
+/*tex The fonts that have been defined in the stream, indexed by font id: */
+
+static unsigned char *shipout_fonts = NULL;
+static int shipout_fonts_size = 0;
+
+/*tex When set, positions are collected here instead of being serialized. */
+
+static flat_page *flat_target = NULL;
+
+/*tex The glyph run that is being collected: */
+
+static int run_font = 0;
+static scaled run_v = 0;
+static int run_count = 0;
+static size_t run_count_ptr = 0;
+
+static void shipout_room(size_t n)
+{
+    if (shipout_ptr + n > shipout_size) {
+        size_t s = shipout_size == 0 ? 65536 : shipout_size;
+        while (shipout_ptr + n > s) {
+            s *= 2;
+        }
+        shipout_buffer = xrealloc(shipout_buffer, (unsigned) s);
+        shipout_size = s;
+    }
+}
+
+static void shipout_put_int(size_t k, int i)
+{
+    unsigned u = (unsigned) i;
+    shipout_buffer[k    ] = (unsigned char) ( u        & 0xFF);
+    shipout_buffer[k + 1] = (unsigned char) ((u >>  8) & 0xFF);
+    shipout_buffer[k + 2] = (unsigned char) ((u >> 16) & 0xFF);
+    shipout_buffer[k + 3] = (unsigned char) ((u >> 24) & 0xFF);
+}
+
+static void shipout_int(int i)
+{
+    shipout_room(4);
+    shipout_put_int(shipout_ptr, i);
+    shipout_ptr += 4;
+}
+
+static void shipout_byte(int b)
+{
+    shipout_room(1);
+    shipout_buffer[shipout_ptr++] = (unsigned char) b;
+}
+
+static void shipout_data(const char *s, size_t l)
+{
+    shipout_int((int) l);
+    shipout_room(l);
+    memcpy(shipout_buffer + shipout_ptr, s, l);
+    shipout_ptr += l;
+}
+
+/*tex
+
+    Consecutive glyphs in the same font on the same baseline end up in one
+    record. Any other record closes the current run first, so that the order of
+    the stream follows the order of the nodes.
+
+*/
+
+static void shipout_end_run(void)
+{
+    if (run_count > 0) {
+        shipout_put_int(run_count_ptr, run_count);
+        run_count = 0;
+    }
+}
+
+static void shipout_record(int r)
+{
+    shipout_end_run();
+    shipout_byte(r);
+}
+
+static int *flat_room(int **a, int *count, int *size, int n)
+{
+    if (*count + n > *size) {
+        *size = *size == 0 ? 1024 : 2 * *size;
+        *a = xrealloc(*a, (unsigned) (*size * (int) sizeof(int)));
+    }
+    *count += n;
+    return *a + *count - n;
+}
+
+static void shipout_string(const char *s)
+{
+    shipout_data(s == NULL ? "" : s, s == NULL ? 0 : strlen(s));
+}
+
+static void shipout_font(int f)
+{
+    if (f >= shipout_fonts_size) {
+        int n = f + 64;
+        shipout_fonts = xrealloc(shipout_fonts, (unsigned) n);
+        memset(shipout_fonts + shipout_fonts_size, 0, (size_t) (n - shipout_fonts_size));
+        shipout_fonts_size = n;
+    }
+    if (! shipout_fonts[f]) {
+        shipout_fonts[f] = 1;
+        shipout_record(font_record);
+        shipout_int(f);
+        shipout_int(font_size(f));
+        shipout_int(font_dsize(f));
+        shipout_string(font_name(f));
+        shipout_string(font_filename(f));
+    }
+}
+
+static void shipout_glyph(halfword p, scaled h, scaled v)
+{
+    if (flat_target != NULL) {
+        int *g = flat_room(&flat_target->glyphs, &flat_target->glyph_count, &flat_target->glyph_size, 4);
+        g[0] = h;
+        g[1] = v;
+        g[2] = font(p);
+        g[3] = character(p);
+        return;
+    }
+    if (run_count == 0 || font(p) != run_font || v != run_v) {
+        shipout_font(font(p));
+        shipout_record(glyph_record);
+        shipout_int(font(p));
+        shipout_int(v);
+        run_count_ptr = shipout_ptr;
+        shipout_int(0);
+        run_font = font(p);
+        run_v = v;
+    }
+    shipout_int(h);
+    shipout_int(character(p));
+    run_count++;
+}
+
+static void shipout_rule(scaled h, scaled v, scaled wd, scaled ht)
+{
+    if (wd > 0 && ht > 0 && flat_target != NULL) {
+        int *r = flat_room(&flat_target->rules, &flat_target->rule_count, &flat_target->rule_size, 4);
+        r[0] = h;
+        r[1] = v;
+        r[2] = wd;
+        r[3] = ht;
+    } else if (wd > 0 && ht > 0) {
+        shipout_record(rule_record);
+        shipout_int(h);
+        shipout_int(v);
+        shipout_int(wd);
+        shipout_int(ht);
+    }
+}
+
+static void shipout_special(int kind, scaled h, scaled v, int id, const char *s, size_t l)
+{
+    shipout_record(special_record);
+    shipout_byte(kind);
+    shipout_int(h);
+    shipout_int(v);
+    shipout_int(id);
+    shipout_data(s, l);
+}
+
+/*tex
+
+    The \.{\\write}, \.{\\openout} and \.{\\closeout} whatsits are executed, the
+    others end up in the stream as specials.
+
+*/
+
+static void shipout_whatsit(halfword p, scaled h, scaled v)
+{
+    if (flat_target != NULL) {
+        return;
+    }
+    switch (subtype(p)) {
+        case open_node:
+        case write_node:
+        case close_node:
+            wrapup_leader(p);
+            break;
+        case late_lua_node:
+            if (late_lua_type(p) == normal && late_lua_data(p) != null) {
+                int l;
+                const char *s = tokenlist_to_tstring(late_lua_data(p), false, &l);
+                shipout_special(late_lua_special, h, v, late_lua_reg(p), s, (size_t) l);
+            }
+            break;
+        case user_defined_node:
+            switch (user_node_type(p)) {
+                case 'd':
+                    {
+                        char s[4];
+                        unsigned u = (unsigned) user_node_value(p);
+                        s[0] = (char) (u & 0xFF);
+                        s[1] = (char) ((u >> 8) & 0xFF);
+                        s[2] = (char) ((u >> 16) & 0xFF);
+                        s[3] = (char) ((u >> 24) & 0xFF);
+                        shipout_special(user_defined_special, h, v, user_node_id(p), s, 4);
+                    }
+                    break;
+                case 's':
+                    {
+                        char b[5];
+                        size_t l;
+                        const char *s = makeclview(user_node_value(p), &l, b);
+                        shipout_special(user_defined_special, h, v, user_node_id(p), s, l);
+                    }
+                    break;
+                case 't':
+                    {
+                        int l;
+                        const char *s = tokenlist_to_tstring(user_node_value(p), false, &l);
+                        shipout_special(user_defined_special, h, v, user_node_id(p), s, (size_t) l);
+                    }
+                    break;
+            }
+            break;
+    }
+}
+
+/*tex The effective size of glue in a set box: */
+
+static scaled shipout_glue(halfword p, halfword this_box)
+{
+    scaled w = width(p);
+    if (glue_sign(this_box) == stretching) {
+        if (stretch_order(p) == glue_order(this_box)) {
+            w += float_round(float_cast(glue_set(this_box)) * stretch(p));
+        }
+    } else if (glue_sign(this_box) == shrinking) {
+        if (shrink_order(p) == glue_order(this_box)) {
+            w -= float_round(float_cast(glue_set(this_box)) * shrink(p));
+        }
+    }
+    return w;
+}
+
+static void shipout_hlist(halfword this_box, scaled left_edge, scaled base_line);
+static void shipout_vlist(halfword this_box, scaled left_edge, scaled top_edge);
+
+static void shipout_box(halfword p, scaled h, scaled v)
+{
+    if (type(p) == hlist_node) {
+        shipout_hlist(p, h, v);
+    } else {
+        shipout_vlist(p, h, v - height(p));
+    }
+}
+
+/*tex
+
+    Horizontal lists are output from the left edge |cur_h| along |base_line|.
+    Direction nodes are not interpreted, everything is set left to right. The
+    discretionaries that survived line breaking contribute their replacement
+    text.
+
+*/
+
+static scaled shipout_hlist_nodes(halfword p, halfword this_box, scaled left_edge, scaled cur_h, scaled base_line)
+{
+    while (p != null) {
+        switch (type(p)) {
+            case glyph_node:
+                shipout_glyph(p, cur_h + x_displace(p), base_line - y_displace(p));
+                if (ex_glyph(p) != 0) {
+                    cur_h += calc_char_width(font(p), character(p), ex_glyph(p));
+                } else {
+                    cur_h += char_width(font(p), character(p));
+                }
+                break;
+            case hlist_node:
+            case vlist_node:
+                if (list_ptr(p) != null) {
+                    shipout_box(p, cur_h, base_line + shift_amount(p));
+                }
+                cur_h += width(p);
+                break;
+            case rule_node:
+                if (subtype(p) != empty_rule) {
+                    scaled ht = is_running(height(p)) ? height(this_box) : height(p);
+                    scaled dp = is_running(depth(p)) ? depth(this_box) : depth(p);
+                    shipout_rule(cur_h, base_line - ht, width(p), ht + dp);
+                }
+                cur_h += width(p);
+                break;
+            case glue_node:
+                {
+                    scaled rule_wd = shipout_glue(p, this_box);
+                    halfword leader_box = leader_ptr(p);
+                    if (subtype(p) >= a_leaders && leader_box != null) {
+                        if (type(leader_box) == rule_node) {
+                            scaled ht = is_running(height(leader_box)) ? height(this_box) : height(leader_box);
+                            scaled dp = is_running(depth(leader_box)) ? depth(this_box) : depth(leader_box);
+                            shipout_rule(cur_h, base_line - ht, rule_wd, ht + dp);
+                        } else {
+                            scaled leader_wd = width(leader_box);
+                            if (leader_wd > 0 && rule_wd > 0) {
+                                /*tex Compensate for floating point rounding. */
+                                scaled edge = cur_h + rule_wd + 10;
+                                scaled lx = 0;
+                                scaled lh = cur_h;
+                                boolean outer_doing_leaders = doing_leaders;
+                                if (subtype(p) == a_leaders || subtype(p) == g_leaders) {
+                                    lh = left_edge + leader_wd * ((cur_h - left_edge) / leader_wd);
+                                    if (lh < cur_h) {
+                                        lh += leader_wd;
+                                    }
+                                } else {
+                                    int lq = (rule_wd + 10) / leader_wd;
+                                    scaled lr = (rule_wd + 10) % leader_wd;
+                                    if (subtype(p) == c_leaders) {
+                                        lh += lr / 2;
+                                    } else {
+                                        lx = lr / (lq + 1);
+                                        lh += (lr - (lq - 1) * lx) / 2;
+                                    }
+                                }
+                                doing_leaders = true;
+                                while (lh + leader_wd <= edge) {
+                                    if (list_ptr(leader_box) != null) {
+                                        shipout_box(leader_box, lh, base_line + shift_amount(leader_box));
+                                    }
+                                    lh += leader_wd + lx;
+                                }
+                                doing_leaders = outer_doing_leaders;
+                            }
+                        }
+                    }
+                    cur_h += rule_wd;
+                }
+                break;
+            case math_node:
+                cur_h += glue_is_zero(p) ? surround(p) : shipout_glue(p, this_box);
+                break;
+            case kern_node:
+            case margin_kern_node:
+                cur_h += width(p);
+                break;
+            case disc_node:
+                cur_h = shipout_hlist_nodes(vlink_no_break(p), this_box, left_edge, cur_h, base_line);
+                break;
+            case whatsit_node:
+                shipout_whatsit(p, cur_h, base_line);
+                break;
+            default:
+                break;
+        }
+        p = vlink(p);
+    }
+    return cur_h;
+}
+
+static void shipout_hlist(halfword this_box, scaled left_edge, scaled base_line)
+{
+    shipout_hlist_nodes(list_ptr(this_box), this_box, left_edge, left_edge, base_line);
+}
+
+/*tex Vertical lists are output downwards from |top_edge|. */
+
+static void shipout_vlist(halfword this_box, scaled left_edge, scaled top_edge)
+{
+    scaled cur_v = top_edge;
+    halfword p = list_ptr(this_box);
+    while (p != null) {
+        switch (type(p)) {
+            case hlist_node:
+            case vlist_node:
+                if (list_ptr(p) != null) {
+                    shipout_box(p, left_edge + shift_amount(p), cur_v + height(p));
+                }
+                cur_v += height(p) + depth(p);
+                break;
+            case rule_node:
+                {
+                    scaled rule_ht = height(p) + depth(p);
+                    if (subtype(p) != empty_rule) {
+                        scaled wd = is_running(width(p)) ? width(this_box) : width(p);
+                        shipout_rule(left_edge, cur_v, wd, rule_ht);
+                    }
+                    cur_v += rule_ht;
+                }
+                break;
+            case glue_node:
+                {
+                    scaled rule_ht = shipout_glue(p, this_box);
+                    halfword leader_box = leader_ptr(p);
+                    if (subtype(p) >= a_leaders && leader_box != null) {
+                        if (type(leader_box) == rule_node) {
+                            scaled wd = is_running(width(leader_box)) ? width(this_box) : width(leader_box);
+                            shipout_rule(left_edge, cur_v, wd, rule_ht);
+                        } else {
+                            scaled leader_ht = height(leader_box) + depth(leader_box);
+                            if (leader_ht > 0 && rule_ht > 0) {
+                                scaled edge = cur_v + rule_ht + 10;
+                                scaled lx = 0;
+                                scaled lv = cur_v;
+                                boolean outer_doing_leaders = doing_leaders;
+                                if (subtype(p) == a_leaders || subtype(p) == g_leaders) {
+                                    lv = top_edge + leader_ht * ((cur_v - top_edge) / leader_ht);
+                                    if (lv < cur_v) {
+                                        lv += leader_ht;
+                                    }
+                                } else {
+                                    int lq = (rule_ht + 10) / leader_ht;
+                                    scaled lr = (rule_ht + 10) % leader_ht;
+                                    if (subtype(p) == c_leaders) {
+                                        lv += lr / 2;
+                                    } else {
+                                        lx = lr / (lq + 1);
+                                        lv += (lr - (lq - 1) * lx) / 2;
+                                    }
+                                }
+                                doing_leaders = true;
+                                while (lv + leader_ht <= edge) {
+                                    if (list_ptr(leader_box) != null) {
+                                        shipout_box(leader_box, left_edge + shift_amount(leader_box), lv + height(leader_box));
+                                    }
+                                    lv += leader_ht + lx;
+                                }
+                                doing_leaders = outer_doing_leaders;
+                            }
+                        }
+                    }
+                    cur_v += rule_ht;
+                }
+                break;
+            case kern_node:
+                cur_v += width(p);
+                break;
+            case whatsit_node:
+                shipout_whatsit(p, left_edge, cur_v);
+                break;
+            default:
+                break;
+        }
+        p = vlink(p);
+    }
+}
+
+/*tex
+
+    Writing the stream is left to a worker thread, so that the main thread can
+    go on typesetting the next page while the previous one goes to disk. The
+    node list itself is not handed over: serializing a page executes \.{\write}
+    whatsits and reads fonts and node memory, all of which can change (or move,
+    when |varmem| grows) while the next page is built. The serialized buffer on
+    the other hand depends on nothing, so the main thread fills it and transfers
+    its ownership to the worker.
+
+    The hand-off is a single producer single consumer ring of buffers. The two
+    indices are only advanced by their owner, and the semaphores just let the
+    sides sleep when the ring is empty or full. A buffer with length zero tells
+    the worker to stop. When no thread can be started we write synchronously.
+
+*/
+
+#define shipout_queue_size 8
+
+typedef struct shipout_page {
+    unsigned char *data;
+    size_t size;
+} shipout_page;
+
+static shipout_page shipout_queue[shipout_queue_size];
+static atomic_uint shipout_queue_head = 0;
+static atomic_uint shipout_queue_tail = 0;
+static sem_t shipout_queue_items;
+static sem_t shipout_queue_slots;
+static pthread_t shipout_thread;
+static boolean shipout_threaded = false;
+static atomic_int shipout_write_error = 0;
+
+static void *shipout_worker(void *arg)
+{
+    (void) arg;
+    while (1) {
+        shipout_page page;
+        unsigned h;
+        sem_wait(&shipout_queue_items);
+        h = atomic_load_explicit(&shipout_queue_head, memory_order_relaxed);
+        page = shipout_queue[h % shipout_queue_size];
+        atomic_store_explicit(&shipout_queue_head, h + 1, memory_order_release);
+        if (page.size == 0) {
+            break;
+        }
+        if (fwrite(page.data, 1, page.size, shipout_file) != page.size) {
+            atomic_store(&shipout_write_error, 1);
+        }
+        free(page.data);
+        sem_post(&shipout_queue_slots);
+    }
+    return NULL;
+}
+
+static void shipout_enqueue(unsigned char *data, size_t size)
+{
+    unsigned t;
+    sem_wait(&shipout_queue_slots);
+    t = atomic_load_explicit(&shipout_queue_tail, memory_order_relaxed);
+    shipout_queue[t % shipout_queue_size].data = data;
+    shipout_queue[t % shipout_queue_size].size = size;
+    atomic_store_explicit(&shipout_queue_tail, t + 1, memory_order_release);
+    sem_post(&shipout_queue_items);
+}
+
+static void shipout_start_worker(void)
+{
+    if (sem_init(&shipout_queue_items, 0, 0) != 0) {
+        return;
+    }
+    if (sem_init(&shipout_queue_slots, 0, shipout_queue_size) != 0) {
+        sem_destroy(&shipout_queue_items);
+        return;
+    }
+    if (pthread_create(&shipout_thread, NULL, shipout_worker, NULL) != 0) {
+        sem_destroy(&shipout_queue_items);
+        sem_destroy(&shipout_queue_slots);
+        return;
+    }
+    shipout_threaded = true;
+}
+
+static void shipout_stop_worker(void)
+{
+    if (shipout_threaded) {
+        shipout_enqueue(NULL, 0);
+        pthread_join(shipout_thread, NULL);
+        sem_destroy(&shipout_queue_items);
+        sem_destroy(&shipout_queue_slots);
+        shipout_threaded = false;
+    }
+}
+
+static void shipout_open(void)
+{
+    if (job_name == 0) {
+        open_log_file();
+    }
+    shipout_name = pack_job_name(".mmo");
+    while ((shipout_file = fopen(shipout_name, "wb")) == NULL) {
+        free(shipout_name);
+        shipout_name = prompt_file_name("output file name", ".mmo");
+    }
+    shipout_ptr = 0;
+    shipout_room(8);
+    memcpy(shipout_buffer, shipout_magic, 4);
+    shipout_ptr = 4;
+    shipout_int(shipout_version);
+    shipout_start_worker();
+}
+
+/*tex
+
+    A failing write is fatal. Because |fatal_error| ends up in |finish_shipout|
+    again, the worker is stopped and the file and the buffer are given up
+    first, so that nothing is written (and reported) twice.
+
+*/
+
+static void shipout_error(void)
+{
+    FILE *f = shipout_file;
+    shipout_stop_worker();
+    atomic_store(&shipout_write_error, 0);
+    shipout_file = NULL;
+    shipout_ptr = 0;
+    run_count = 0;
+    if (f != NULL) {
+        fclose(f);
+    }
+    fatal_error("*** (error writing the output file)");
+}
+
+static void shipout_flush(void)
+{
+    if (atomic_load(&shipout_write_error)) {
+        shipout_error();
+    }
+    if (shipout_ptr > 0) {
+        if (shipout_threaded) {
+            /*tex The worker frees the buffer, we start a fresh one. */
+            shipout_enqueue(shipout_buffer, shipout_ptr);
+            shipout_buffer = NULL;
+            shipout_size = 0;
+        } else if (fwrite(shipout_buffer, 1, shipout_ptr, shipout_file) != shipout_ptr) {
+            shipout_error();
+        }
+        shipout_bytes += (int) shipout_ptr;
+        shipout_ptr = 0;
+    }
+}
+
+/*tex
+
+    When a |shipout| callback takes the page, the stream walker doesn't run, but
+    the \.{\write}, \.{\openout} and \.{\closeout} whatsits still have to be
+    executed, in the same order and, like there, not in leaders.
+
+*/
+
+static void shipout_writes(halfword p)
+{
+    while (p != null) {
+        switch (type(p)) {
+            case hlist_node:
+            case vlist_node:
+                shipout_writes(list_ptr(p));
+                break;
+            case disc_node:
+                shipout_writes(vlink_no_break(p));
+                break;
+            case whatsit_node:
+                switch (subtype(p)) {
+                    case open_node:
+                    case write_node:
+                    case close_node:
+                        wrapup_leader(p);
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            default:
+                break;
+        }
+        p = vlink(p);
+    }
+}
+
+/*tex
+
+    The page box |p| is consumed: after it has been serialized and written its
+    nodes are flushed.
+
+*/
+
+void ship_out(halfword p)
+{
+    int j, k;
+    int callback_id;
+    if (tracing_output_par > 0) {
+        tprint_nl("");
+        print_ln();
+        tprint("Completed box being shipped out");
+    }
+    if (term_offset > max_print_line - 9) {
+        print_ln();
+    } else if ((term_offset > 0) || (file_offset > 0)) {
+        print_char(' ');
+    }
+    print_char('[');
+    j = 9;
+    while ((count(j) == 0) && (j > 0)) {
+        j--;
+    }
+    for (k = 0; k <= j; k++) {
+        print_int(count(k));
+        if (k < j) {
+            print_char('.');
+        }
+    }
+    update_terminal();
+    if (tracing_output_par > 0) {
+        print_char(']');
+        begin_diagnostic();
+        show_box(p);
+        end_diagnostic(true);
+    }
+    if ((height(p) > max_dimen) || (depth(p) > max_dimen) || (width(p) > max_dimen)) {
+        print_err("Huge page cannot be shipped out");
+        help2(
+            "The page just created is more than 18 feet tall or",
+            "more than 18 feet wide, so I suspect something went wrong."
+        );
+        error();
+        if (tracing_output_par <= 0) {
+            begin_diagnostic();
+            tprint_nl("The following box has been deleted:");
+            show_box(p);
+            end_diagnostic(true);
+        }
+    } else if ((callback_id = callback_defined(shipout_callback)) > 0) {
+        /*tex The page now belongs to the callback, which has to flush it. */
+        shipout_writes(list_ptr(p));
+        incr(total_pages);
+        run_callback(callback_id, "d->", p);
+        p = null;
+    } else {
+        if (shipout_file == NULL) {
+            shipout_open();
+        }
+        incr(total_pages);
+        shipout_byte(page_record);
+        shipout_int(total_pages);
+        shipout_int(width(p));
+        shipout_int(height(p));
+        shipout_int(depth(p));
+        if (list_ptr(p) != null) {
+            shipout_box(p, 0, height(p));
+        }
+        shipout_record(end_record);
+        shipout_flush();
+    }
+    dead_cycles = 0;
+    if (tracing_output_par <= 0) {
+        print_char(']');
+    }
+    update_terminal();
+    flush_node_list(p);
+}
+
+/*tex
+
+    This collects the glyphs (left, baseline, font, character) and rules (left,
+    top, width, height) of box |p| with the same walker as the stream uses, so a
+    backend written in \LUA\ can get a page in one go. Whatsits are ignored and
+    |f| should be zeroed by the caller, who also frees the arrays.
+
+*/
+
+void flatten_page(halfword p, flat_page *f)
+{
+    flat_page *saved_target = flat_target;
+    flat_target = f;
+    if (list_ptr(p) != null) {
+        shipout_box(p, 0, height(p));
+    }
+    flat_target = saved_target;
+}
+
+void finish_shipout(void)
+{
+    if (shipout_file != NULL) {
+        shipout_byte(final_record);
+        shipout_int(total_pages);
+        shipout_flush();
+        shipout_stop_worker();
+        if (atomic_load(&shipout_write_error)) {
+            shipout_error();
+        }
+        if (fclose(shipout_file) != 0) {
+            shipout_file = NULL;
+            shipout_error();
+        }
+        shipout_file = NULL;
+        tprint_nl("Output written on ");
+        tprint(shipout_name);
+        tprint(" (");
+        print_int(total_pages);
+        tprint(total_pages != 1 ? " pages" : " page");
+        tprint(", ");
+        print_int(shipout_bytes);
+        tprint(" bytes).");
+        free(shipout_name);
+        shipout_name = NULL;
+    } else if (total_pages == 0) {
+        tprint_nl("No pages of output.");
+    }
+    free(shipout_buffer);
+    shipout_buffer = NULL;
+    shipout_size = 0;
+    free(shipout_fonts);
+    shipout_fonts = NULL;
+    shipout_fonts_size = 0;
+}
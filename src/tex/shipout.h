@@ -0,0 +1,55 @@
+/* shipout.h
+
+   This file is part of LuaTeX.
+
+   LuaTeX is free software; you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free
+   Software Foundation; either version 2 of the License, or (at your
+   option) any later version.
+
+   LuaTeX is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with LuaTeX; if not, see <http://www.gnu.org/licenses/>. */
+
+
+#ifndef SHIPOUT_H
+#  define SHIPOUT_H
+
+#  define shipout_magic   "MMOB"
+#  define shipout_version 2
+
+typedef enum {
+    font_record    = 'D',
+    page_record    = 'P',
+    glyph_record   = 'G',
+    rule_record    = 'R',
+    special_record = 'S',
+    end_record     = 'E',
+    final_record   = 'F',
+} shipout_records;
+
+typedef enum {
+    late_lua_special     = 1,
+    user_defined_special = 2,
+} shipout_specials;
+
+typedef struct flat_page {
+    int *glyphs;
+    int glyph_count;
+    int glyph_size;
+    int *rules;
+    int rule_count;
+    int rule_size;
+} flat_page;
+
+extern int shipout_bytes;
+
+extern void ship_out(halfword p);
+extern void finish_shipout(void);
+extern void flatten_page(halfword p, flat_page *f);
+
+#endif
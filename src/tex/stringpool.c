@@ -302,6 +302,32 @@ char *makeclstring(int s, size_t * len)
     }
 }
 
+/*tex
+
+Pool strings are always zero terminated, so when we only need to look at one,
+for instance to push it to \LUA, there is no need for a copy. Single character
+strings are not stored, so these are encoded into |buf|, which should have room
+for at least five bytes. The result is only valid as long as the string (and
+|buf|) exists.
+
+*/
+
+const char *makeclview(int s, size_t * len, char *buf)
+{
+    if (s < STRING_OFFSET) {
+        char *e = uni2string(buf, (unsigned) s);
+        *e = '\0';
+        *len = (size_t) (e - buf);
+        return buf;
+    } else if (str_string(s) == NULL) {
+        *len = 0;
+        return "";
+    } else {
+        *len = (size_t) str_length(s);
+        return (const char *) str_string(s);
+    }
+}
+
 int dump_string_pool(void)
 {
     int j;
@@ -373,3 +399,74 @@ void flush_str(str_number s)
     while (str_string((str_ptr - 1)) == NULL)
         str_ptr--;
 }
+
+/*tex
+
+    Strings are only given back when their owner calls |flush_str|, and many
+    strings that are made during a run (file names, font names, strings set from
+    \LUA) are never flushed. The collector below marks the strings that are
+    still referenced from the hash (which also has the font identifiers), the
+    primitive table, the input stack, the file name variables, fonts and nodes,
+    and flushes the other ones that were made during this run; strings that come
+    from the format are left alone. String numbers are identifiers, so we cannot
+    compact them, but as with |flush_str| the slots at the top are reused.
+
+    The collector has to run at a moment where no string numbers are kept in
+    local variables, for instance from \.{\directlua}.
+
+*/
+
+int reclaimed_string_count = 0;
+int reclaimed_string_bytes = 0;
+
+static unsigned char *string_marks = NULL;
+
+void mark_string(str_number s)
+{
+    if (string_marks != NULL && s >= init_str_ptr && s < str_ptr)
+        string_marks[s - init_str_ptr] = 1;
+}
+
+int collect_strings(void)
+{
+    int bytes = 0;
+    int n = str_ptr - init_str_ptr;
+    int i;
+    str_number s;
+    if (n <= 0 || init_str_ptr <= STRING_OFFSET)
+        return 0;
+    string_marks = xcalloc((unsigned) n, 1);
+    if (! mark_node_strings()) {
+        xfree(string_marks);
+        return 0;
+    }
+    for (i = 0; i <= hash_top; i++)
+        mark_string(hash[i].rh);
+    for (i = 0; i <= prim_size; i++)
+        mark_string(get_prim_text(i));
+    for (i = 0; i < input_ptr; i++)
+        mark_string(input_stack[i].name_field);
+    mark_string(cur_input.name_field);
+    for (i = 0; i <= in_open; i++)
+        mark_string(source_filename_stack[i]);
+    for (i = 0; i <= max_font_id(); i++) {
+        if (font_tables[i] != NULL)
+            mark_string(pdf_font_attr(i));
+    }
+    mark_string(job_name);
+    mark_string(format_ident);
+    mark_string(format_name);
+    mark_string(cur_name);
+    mark_string(cur_area);
+    mark_string(cur_ext);
+    for (s = str_ptr - 1; s >= init_str_ptr; s--) {
+        if (! string_marks[s - init_str_ptr] && str_string(s) != NULL) {
+            bytes += (int) str_length(s);
+            reclaimed_string_count++;
+            flush_str(s);
+        }
+    }
+    xfree(string_marks);
+    reclaimed_string_bytes += bytes;
+    return bytes;
+}
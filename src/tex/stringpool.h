@@ -134,6 +134,7 @@ extern void append_string(const unsigned char *s, unsigned l);
 
 extern char *makecstring(int);
 extern char *makeclstring(int, size_t *);
+extern const char *makeclview(int, size_t *, char *);
 
 extern int dump_string_pool(void);
 extern int undump_string_pool(void);
@@ -141,4 +142,9 @@ extern int undump_string_pool(void);
 extern void init_string_pool_array(unsigned s);
 extern void flush_str(str_number s);
 
+extern int reclaimed_string_count;
+extern int reclaimed_string_bytes;
+extern void mark_string(str_number s);
+extern int collect_strings(void);
+
 #endif
@@ -967,6 +967,35 @@ boolean zopen_w_output(FILE ** f, const char *s, const_string fopen_mode)
     return res;
 }
 
+/*tex
+
+    The font cache uses the same (un)dump routines on plain files that are
+    found without any callback. A font can be loaded while a format is being
+    read or written, so the descriptor of that file is kept and put back when
+    the cache file is closed.
+
+*/
+
+static int saved_fmtfile = -1;
+
+boolean zopen_w_cache(FILE ** f, const char *fname, const_string fopen_mode)
+{
+    *f = fopen(fname, fopen_mode);
+    if (*f == NULL) {
+        return 0;
+    }
+    saved_fmtfile = gz_fmtfile;
+    gz_fmtfile = fileno(*f);
+    return 1;
+}
+
+void zclose_w_cache(FILE * f)
+{
+    fclose(f);
+    gz_fmtfile = saved_fmtfile;
+    saved_fmtfile = -1;
+}
+
 void zwclose(FILE * f)
 {
     (void) f;
@@ -109,6 +109,8 @@ extern void start_input(void);
 
 extern boolean zopen_w_input(FILE **, const char *, const_string fopen_mode);
 extern boolean zopen_w_output(FILE **, const char *, const_string fopen_mode);
+extern boolean zopen_w_cache(FILE **, const char *, const_string fopen_mode);
+extern void zclose_w_cache(FILE *);
 extern void zwclose(FILE *);
 
 #  ifdef WIN32
@@ -178,6 +178,15 @@ void flush_math(void)
 
 static sa_tree math_fam_head = NULL;
 
+/*tex
+
+    This counter changes whenever a family font or a math parameter changes, so
+    that results computed for the old settings can be recognized as stale.
+
+*/
+
+int math_data_generation = 0;
+
 int fam_fnt(int fam_id, int size_id)
 {
     int n = fam_id + (256 * size_id);
@@ -190,6 +199,7 @@ void def_fam_fnt(int fam_id, int size_id, int f, int lvl)
     sa_tree_item sa_value = { 0 };
     sa_value.int_value = f;
     set_sa_item(math_fam_head, n, sa_value, lvl);
+    math_data_generation++;
     fixup_math_parameters(fam_id, size_id, f, lvl);
     if (tracing_assigns_par > 1) {
         begin_diagnostic();
@@ -215,6 +225,7 @@ static void unsave_math_fam_data(int gl)
         st = math_fam_head->stack[math_fam_head->stack_ptr];
         if (st.level > 0) {
             rawset_sa_item(math_fam_head, st.code, st.value);
+            math_data_generation++;
             /*tex Now do a trace message, if requested. */
             if (tracing_restores_par > 1) {
                 int size_id = st.code / 256;
@@ -241,12 +252,64 @@ static void unsave_math_fam_data(int gl)
 
 static sa_tree math_param_head = NULL;
 
+/*tex
+
+    The parameters are looked up many times per formula, so we keep a flat copy
+    of them per style. A row is filled from the tree on first use and is then
+    kept in sync by the assignments and restores below. A local assignment of
+    the value that is already there, as happens a lot when families are set
+    up, is a no-op that needs no save stack entry, like a reassignment in
+    \ETEX.
+
+*/
+
+#define MATHPARAMSTYLES 8
+
+static scaled math_param_cache[MATHPARAMSTYLES][math_param_last];
+static int math_param_cache_valid = 0;
+
+#define valid_math_param_cache(p,s) \
+    ((p) >= 0 && (p) < math_param_last && (s) >= 0 && (s) < MATHPARAMSTYLES)
+
+static void fill_math_param_cache(int style_id)
+{
+    int param_id;
+    for (param_id = 0; param_id < math_param_last; param_id++) {
+        math_param_cache[style_id][param_id] = (scaled)
+            get_sa_item(math_param_head, param_id + (256 * style_id)).int_value;
+    }
+    math_param_cache_valid |= (1 << style_id);
+}
+
+static void update_math_param_cache(int param_id, int style_id, scaled value)
+{
+    if (valid_math_param_cache(param_id, style_id) && (math_param_cache_valid & (1 << style_id))) {
+        math_param_cache[style_id][param_id] = value;
+    }
+}
+
 void def_math_param(int param_id, int style_id, scaled value, int lvl)
 {
     int n = param_id + (256 * style_id);
     sa_tree_item sa_value = { 0 };
+    if (lvl > level_one && get_math_param(param_id, style_id) == value) {
+        if (tracing_assigns_par > 1) {
+            begin_diagnostic();
+            tprint("{reassigning");
+            print_char(' ');
+            print_cmd_chr(set_math_param_cmd, param_id);
+            print_cmd_chr(math_style_cmd, style_id);
+            print_char('=');
+            print_int(value);
+            print_char('}');
+            end_diagnostic(false);
+        }
+        return;
+    }
     sa_value.int_value = (int) value;
     set_sa_item(math_param_head, n, sa_value, lvl);
+    update_math_param_cache(param_id, style_id, value);
+    math_data_generation++;
     if (tracing_assigns_par > 1) {
         begin_diagnostic();
         tprint("{assigning");
@@ -262,8 +325,14 @@ void def_math_param(int param_id, int style_id, scaled value, int lvl)
 
 scaled get_math_param(int param_id, int style_id)
 {
-    int n = param_id + (256 * style_id);
-    return (scaled) get_sa_item(math_param_head, n).int_value;
+    if (valid_math_param_cache(param_id, style_id)) {
+        if (! (math_param_cache_valid & (1 << style_id))) {
+            fill_math_param_cache(style_id);
+        }
+        return math_param_cache[style_id][param_id];
+    } else {
+        return (scaled) get_sa_item(math_param_head, param_id + (256 * style_id)).int_value;
+    }
 }
 
 static void unsave_math_param_data(int gl)
@@ -277,6 +346,8 @@ static void unsave_math_param_data(int gl)
         st = math_param_head->stack[math_param_head->stack_ptr];
         if (st.level > 0) {
             rawset_sa_item(math_param_head, st.code, st.value);
+            update_math_param_cache(st.code % 256, st.code / 256, (scaled) st.value.int_value);
+            math_data_generation++;
             /*tex Do a trace message, if requested. */
             if (tracing_restores_par > 1) {
                 int param_id = st.code % 256;
@@ -325,6 +396,8 @@ void undump_math_data(void)
 {
     math_fam_head = undump_sa_tree("mathfonts");
     math_param_head = undump_sa_tree("mathparameters");
+    math_param_cache_valid = 0;
+    math_data_generation++;
 }
 
 void initialize_math(void)
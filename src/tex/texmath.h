@@ -64,6 +64,7 @@ extern void scan_extdef_math_code(int level, int extcode);
 
 extern int fam_fnt(int fam_id, int size_id);
 extern void def_fam_fnt(int fam_id, int size_id, int f, int lvl);
+extern int math_data_generation;
 extern void dump_math_data(void);
 extern void undump_math_data(void);
 void unsave_math_data(int lvl);
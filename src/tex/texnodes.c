@@ -46,6 +46,20 @@ halfword rover = 0;
 
 halfword free_chain[MAX_CHAIN_SIZE] = { null };
 
+/*tex
+
+    Glyph nodes are by far the most common nodes and passes like hyphenation,
+    line breaking and packaging mostly walk long runs of them. When the free
+    chain for glyphs is exhausted we therefore carve a whole run of glyph slots
+    out of one block, so that consecutive characters end up next to each other
+    in |varmem|.
+
+*/
+
+#define glyph_run_length 64
+
+int glyph_runs_allocated = 0;
+
 static int my_prealloc = 0;
 
 /*tex Used in font and lang: */
@@ -1009,6 +1023,23 @@ int lua_properties_level         = 0 ;
 int lua_properties_enabled       = 0 ;
 int lua_properties_use_metatable = 0 ;
 
+/*tex
+
+    Only a few nodes ever get properties, so we keep a bit per node that tells
+    if it has an entry in the table, and only then bother \LUA\ when a node is
+    copied or freed. The bit is set when a property is assigned by the library
+    functions. Once the raw table has been given to \LUA, entries can be set
+    behind our back, so from then on we consult the table for every node, as
+    before.
+
+*/
+
+unsigned char *varmem_properties = NULL;
+int lua_properties_untracked     = 0 ;
+
+#define lua_properties_wanted(target) \
+    (lua_properties_enabled && (lua_properties_untracked || node_has_properties(target)))
+
 /*tex
 
     We keep track of nesting so that we don't oveflow the stack, and, what is
@@ -1041,7 +1072,7 @@ int lua_properties_use_metatable = 0 ;
 /*tex Resetting boils down to nilling. */
 
 #define lua_properties_reset(target) do { \
-    if (lua_properties_enabled) { \
+    if (lua_properties_wanted(target)) { \
         if (lua_properties_level == 0) { \
             lua_get_metatablelua_l(Luas,node_properties); \
             lua_pushnil(Luas); \
@@ -1051,6 +1082,7 @@ int lua_properties_use_metatable = 0 ;
             lua_pushnil(Luas); \
             lua_rawseti(Luas,-2,target); \
         } \
+        reset_node_has_properties(target); \
     } \
 } while(0)
 
@@ -1146,7 +1178,7 @@ int lua_properties_use_metatable = 0 ;
 */
 
 #define lua_properties_copy(target,source) do { \
-    if (lua_properties_enabled) { \
+    if (lua_properties_wanted(source)) { \
         if (lua_properties_level == 0) { \
             lua_get_metatablelua_l(Luas,node_properties); \
             lua_rawgeti(Luas,-1,source); \
@@ -1162,6 +1194,7 @@ int lua_properties_use_metatable = 0 ;
                     lua_setmetatable(Luas,-2); \
                 } \
                 lua_rawseti(Luas,-2,target); \
+                set_node_has_properties(target); \
             } else { \
                 lua_pop(Luas,1); \
             } \
@@ -1180,6 +1213,7 @@ int lua_properties_use_metatable = 0 ;
                     lua_setmetatable(Luas,-2); \
                 } \
                 lua_rawseti(Luas,-2,target); \
+                set_node_has_properties(target); \
             } else { \
                 lua_pop(Luas,1); \
             } \
@@ -1203,6 +1237,36 @@ int valid_node(halfword p)
     return 0;
 }
 
+/*tex
+
+    The string collector in |stringpool.c| needs to know which strings are still
+    referenced from nodes: the file name parts of |open_node|s and the values of
+    string valued user nodes. This is only possible when we keep track of the
+    node sizes, which tells us which nodes are in use.
+
+*/
+
+boolean mark_node_strings(void)
+{
+#ifdef CHECK_NODE_USAGE
+    halfword p;
+    for (p = my_prealloc + 1; p < var_mem_max; p++) {
+        if (varmem_sizes[p] > 0 && type(p) == whatsit_node) {
+            if (subtype(p) == open_node) {
+                mark_string(open_name(p));
+                mark_string(open_area(p));
+                mark_string(open_ext(p));
+            } else if (subtype(p) == user_defined_node && user_node_type(p) == 's') {
+                mark_string(user_node_value(p));
+            }
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
 static int test_count = 1;
 
 #define dorangetest(a,b,c)  do {                                 \
@@ -1623,6 +1687,438 @@ halfword new_glyph_node(void)
     return n;
 }
 
+/*tex
+
+    A structural hash of a node list, for instance to recognize a paragraph that
+    was seen before. It is stable between runs: pointers are never hashed, sub
+    lists, token lists, strings and attribute lists are hashed by content. When
+    the list has something that can't be hashed this way, like an unknown node,
+    a \LUA\ reference or properties, |complete| is cleared and equal hashes don't
+    imply equal lists.
+
+*/
+
+#define node_hash_step(h,v) h = ((h) ^ (uint64_t) (unsigned) (v)) * 0x100000001b3ULL
+
+static uint64_t hash_nodes(uint64_t h, halfword p, int *complete);
+
+static uint64_t hash_tokens(uint64_t h, halfword t)
+{
+    /*tex We skip the reference count. */
+    if (t != null) {
+        t = token_link(t);
+    }
+    while (t != null) {
+        node_hash_step(h, token_info(t));
+        t = token_link(t);
+    }
+    return h;
+}
+
+static uint64_t hash_string(uint64_t h, int s)
+{
+    char b[5];
+    size_t l;
+    const char *c = makeclview(s, &l, b);
+    while (l-- > 0) {
+        node_hash_step(h, (unsigned char) *c++);
+    }
+    return h;
+}
+
+static uint64_t hash_glue(uint64_t h, halfword p)
+{
+    node_hash_step(h, width(p));
+    node_hash_step(h, stretch(p));
+    node_hash_step(h, shrink(p));
+    node_hash_step(h, stretch_order(p));
+    node_hash_step(h, shrink_order(p));
+    return h;
+}
+
+static uint64_t hash_nodes(uint64_t h, halfword p, int *complete)
+{
+    while (p != null) {
+        node_hash_step(h, type(p));
+        node_hash_step(h, subtype(p));
+        if (lua_properties_wanted(p)) {
+            /*tex Once the table has been given out we can't tell, so we assume there are. */
+            *complete = 0;
+        }
+        if (nodetype_has_attributes(type(p)) && node_attr(p) != null) {
+            halfword a = vlink(node_attr(p));
+            while (a != null) {
+                node_hash_step(h, attribute_id(a));
+                node_hash_step(h, attribute_value(a));
+                a = vlink(a);
+            }
+        }
+        switch (type(p)) {
+            case glyph_node:
+                node_hash_step(h, character(p));
+                node_hash_step(h, font(p));
+                node_hash_step(h, lang_data(p));
+                node_hash_step(h, x_displace(p));
+                node_hash_step(h, y_displace(p));
+                node_hash_step(h, ex_glyph(p));
+                node_hash_step(h, glyph_node_data(p));
+                h = hash_nodes(h, lig_ptr(p), complete);
+                break;
+            case hlist_node:
+            case vlist_node:
+                {
+                    uint64_t g = 0;
+                    double d = (double) glue_set(p);
+                    memcpy(&g, &d, sizeof(g));
+                    node_hash_step(h, width(p));
+                    node_hash_step(h, depth(p));
+                    node_hash_step(h, height(p));
+                    node_hash_step(h, shift_amount(p));
+                    node_hash_step(h, box_dir(p));
+                    node_hash_step(h, glue_order(p));
+                    node_hash_step(h, glue_sign(p));
+                    node_hash_step(h, g);
+                    node_hash_step(h, g >> 32);
+                    h = hash_nodes(h, list_ptr(p), complete);
+                }
+                break;
+            case rule_node:
+                node_hash_step(h, width(p));
+                node_hash_step(h, depth(p));
+                node_hash_step(h, height(p));
+                node_hash_step(h, rule_dir(p));
+                node_hash_step(h, rule_index(p));
+                node_hash_step(h, rule_transform(p));
+                node_hash_step(h, rule_left(p));
+                node_hash_step(h, rule_right(p));
+                break;
+            case glue_node:
+                h = hash_glue(h, p);
+                h = hash_nodes(h, leader_ptr(p), complete);
+                break;
+            case glue_spec_node:
+                h = hash_glue(h, p);
+                break;
+            case math_node:
+                h = hash_glue(h, p);
+                node_hash_step(h, surround(p));
+                break;
+            case kern_node:
+                node_hash_step(h, width(p));
+                node_hash_step(h, ex_kern(p));
+                break;
+            case margin_kern_node:
+                node_hash_step(h, width(p));
+                h = hash_nodes(h, margin_char(p), complete);
+                break;
+            case penalty_node:
+                node_hash_step(h, penalty(p));
+                break;
+            case disc_node:
+                node_hash_step(h, disc_penalty(p));
+                h = hash_nodes(h, vlink_pre_break(p), complete);
+                node_hash_step(h, disc_node);
+                h = hash_nodes(h, vlink_post_break(p), complete);
+                node_hash_step(h, disc_node);
+                h = hash_nodes(h, vlink_no_break(p), complete);
+                break;
+            case boundary_node:
+                node_hash_step(h, boundary_value(p));
+                break;
+            case dir_node:
+                node_hash_step(h, dir_dir(p));
+                break;
+            case local_par_node:
+                node_hash_step(h, local_pen_inter(p));
+                node_hash_step(h, local_pen_broken(p));
+                node_hash_step(h, local_box_left_width(p));
+                node_hash_step(h, local_box_right_width(p));
+                node_hash_step(h, local_par_dir(p));
+                h = hash_nodes(h, local_box_left(p), complete);
+                h = hash_nodes(h, local_box_right(p), complete);
+                break;
+            case mark_node:
+                node_hash_step(h, mark_class(p));
+                h = hash_tokens(h, mark_ptr(p));
+                break;
+            case adjust_node:
+                h = hash_nodes(h, adjust_ptr(p), complete);
+                break;
+            case ins_node:
+                node_hash_step(h, float_cost(p));
+                node_hash_step(h, depth(p));
+                node_hash_step(h, height(p));
+                h = hash_nodes(h, ins_ptr(p), complete);
+                h = hash_nodes(h, split_top_ptr(p), complete);
+                break;
+            case whatsit_node:
+                switch (subtype(p)) {
+                    case open_node:
+                        node_hash_step(h, write_stream(p));
+                        h = hash_string(h, open_name(p));
+                        h = hash_string(h, open_area(p));
+                        h = hash_string(h, open_ext(p));
+                        break;
+                    case write_node:
+                    case close_node:
+                        node_hash_step(h, write_stream(p));
+                        h = hash_tokens(h, write_tokens(p));
+                        break;
+                    case late_lua_node:
+                        node_hash_step(h, late_lua_type(p));
+                        if (late_lua_type(p) == normal) {
+                            h = hash_tokens(h, late_lua_data(p));
+                        } else {
+                            *complete = 0;
+                        }
+                        break;
+                    case user_defined_node:
+                        node_hash_step(h, user_node_id(p));
+                        node_hash_step(h, user_node_type(p));
+                        switch (user_node_type(p)) {
+                            case 'd':
+                                node_hash_step(h, user_node_value(p));
+                                break;
+                            case 's':
+                                h = hash_string(h, user_node_value(p));
+                                break;
+                            case 't':
+                                h = hash_tokens(h, user_node_value(p));
+                                break;
+                            case 'n':
+                                h = hash_nodes(h, user_node_value(p), complete);
+                                break;
+                            default:
+                                *complete = 0;
+                                break;
+                        }
+                        break;
+                    default:
+                        *complete = 0;
+                        break;
+                }
+                break;
+            default:
+                *complete = 0;
+                break;
+        }
+        p = vlink(p);
+    }
+    /*tex This separates a sub list from what follows it. */
+    node_hash_step(h, 0xFFFF);
+    return h;
+}
+
+uint64_t hash_node_list(halfword p, int *complete)
+{
+    *complete = 1;
+    return hash_nodes(0xcbf29ce484222325ULL, p, complete);
+}
+
+/*tex
+
+    The companion of the hash: two lists are the same when they have the same
+    content in the fields that are hashed. Lists that can't be hashed
+    completely are never the same, so a hash hit can always be verified with
+    this.
+
+*/
+
+static boolean same_tokens(halfword s, halfword t)
+{
+    if (s != null) {
+        s = token_link(s);
+    }
+    if (t != null) {
+        t = token_link(t);
+    }
+    while (s != null && t != null) {
+        if (token_info(s) != token_info(t))
+            return false;
+        s = token_link(s);
+        t = token_link(t);
+    }
+    return s == t;
+}
+
+static boolean same_string(int s, int t)
+{
+    char b[5], c[5];
+    size_t k, l;
+    const char *u = makeclview(s, &k, b);
+    const char *v = makeclview(t, &l, c);
+    return k == l && memcmp(u, v, k) == 0;
+}
+
+static boolean same_attributes(halfword a, halfword b)
+{
+    if (a == b)
+        return true;
+    if (a == null || b == null)
+        return false;
+    a = vlink(a);
+    b = vlink(b);
+    while (a != null && b != null) {
+        if (attribute_id(a) != attribute_id(b) || attribute_value(a) != attribute_value(b))
+            return false;
+        a = vlink(a);
+        b = vlink(b);
+    }
+    return a == b;
+}
+
+#define same_glue(p,q) \
+    (width(p) == width(q) && stretch(p) == stretch(q) && shrink(p) == shrink(q) && \
+     stretch_order(p) == stretch_order(q) && shrink_order(p) == shrink_order(q))
+
+#define same_field(f) (f(p) == f(q))
+
+boolean same_node_list(halfword p, halfword q)
+{
+    while (p != null && q != null) {
+        if (type(p) != type(q) || subtype(p) != subtype(q))
+            return false;
+        if (lua_properties_wanted(p) || lua_properties_wanted(q))
+            return false;
+        if (nodetype_has_attributes(type(p)) && ! same_attributes(node_attr(p), node_attr(q)))
+            return false;
+        switch (type(p)) {
+            case glyph_node:
+                if (! (same_field(character) && same_field(font) && same_field(lang_data)
+                    && same_field(x_displace) && same_field(y_displace) && same_field(ex_glyph)
+                    && same_field(glyph_node_data) && same_node_list(lig_ptr(p), lig_ptr(q))))
+                    return false;
+                break;
+            case hlist_node:
+            case vlist_node:
+                if (! (same_field(width) && same_field(depth) && same_field(height)
+                    && same_field(shift_amount) && same_field(box_dir) && same_field(glue_order)
+                    && same_field(glue_sign) && (double) glue_set(p) == (double) glue_set(q)
+                    && same_node_list(list_ptr(p), list_ptr(q))))
+                    return false;
+                break;
+            case rule_node:
+                if (! (same_field(width) && same_field(depth) && same_field(height)
+                    && same_field(rule_dir) && same_field(rule_index) && same_field(rule_transform)
+                    && same_field(rule_left) && same_field(rule_right)))
+                    return false;
+                break;
+            case glue_node:
+                if (! (same_glue(p, q) && same_node_list(leader_ptr(p), leader_ptr(q))))
+                    return false;
+                break;
+            case glue_spec_node:
+                if (! same_glue(p, q))
+                    return false;
+                break;
+            case math_node:
+                if (! (same_glue(p, q) && same_field(surround)))
+                    return false;
+                break;
+            case kern_node:
+                if (! (same_field(width) && same_field(ex_kern)))
+                    return false;
+                break;
+            case margin_kern_node:
+                if (! (same_field(width) && same_node_list(margin_char(p), margin_char(q))))
+                    return false;
+                break;
+            case penalty_node:
+                if (! same_field(penalty))
+                    return false;
+                break;
+            case disc_node:
+                if (! (same_field(disc_penalty)
+                    && same_node_list(vlink_pre_break(p), vlink_pre_break(q))
+                    && same_node_list(vlink_post_break(p), vlink_post_break(q))
+                    && same_node_list(vlink_no_break(p), vlink_no_break(q))))
+                    return false;
+                break;
+            case boundary_node:
+                if (! same_field(boundary_value))
+                    return false;
+                break;
+            case dir_node:
+                if (! same_field(dir_dir))
+                    return false;
+                break;
+            case local_par_node:
+                if (! (same_field(local_pen_inter) && same_field(local_pen_broken)
+                    && same_field(local_box_left_width) && same_field(local_box_right_width)
+                    && same_field(local_par_dir)
+                    && same_node_list(local_box_left(p), local_box_left(q))
+                    && same_node_list(local_box_right(p), local_box_right(q))))
+                    return false;
+                break;
+            case mark_node:
+                if (! (same_field(mark_class) && same_tokens(mark_ptr(p), mark_ptr(q))))
+                    return false;
+                break;
+            case adjust_node:
+                if (! same_node_list(adjust_ptr(p), adjust_ptr(q)))
+                    return false;
+                break;
+            case ins_node:
+                if (! (same_field(float_cost) && same_field(depth) && same_field(height)
+                    && same_node_list(ins_ptr(p), ins_ptr(q))
+                    && same_node_list(split_top_ptr(p), split_top_ptr(q))))
+                    return false;
+                break;
+            case whatsit_node:
+                switch (subtype(p)) {
+                    case open_node:
+                        if (! (same_field(write_stream) && same_string(open_name(p), open_name(q))
+                            && same_string(open_area(p), open_area(q))
+                            && same_string(open_ext(p), open_ext(q))))
+                            return false;
+                        break;
+                    case write_node:
+                    case close_node:
+                        if (! (same_field(write_stream) && same_tokens(write_tokens(p), write_tokens(q))))
+                            return false;
+                        break;
+                    case late_lua_node:
+                        if (! (late_lua_type(p) == normal && same_field(late_lua_type)
+                            && same_tokens(late_lua_data(p), late_lua_data(q))))
+                            return false;
+                        break;
+                    case user_defined_node:
+                        if (! (same_field(user_node_id) && same_field(user_node_type)))
+                            return false;
+                        switch (user_node_type(p)) {
+                            case 'd':
+                                if (! same_field(user_node_value))
+                                    return false;
+                                break;
+                            case 's':
+                                if (! same_string(user_node_value(p), user_node_value(q)))
+                                    return false;
+                                break;
+                            case 't':
+                                if (! same_tokens(user_node_value(p), user_node_value(q)))
+                                    return false;
+                                break;
+                            case 'n':
+                                if (! same_node_list(user_node_value(p), user_node_value(q)))
+                                    return false;
+                                break;
+                            default:
+                                return false;
+                        }
+                        break;
+                    default:
+                        return false;
+                }
+                break;
+            default:
+                return false;
+        }
+        p = vlink(p);
+        q = vlink(q);
+    }
+    return p == q;
+}
+
 /*tex
 
     This makes a duplicate of the node list that starts at |p| and returns a
@@ -1747,6 +2243,9 @@ halfword copy_node(const halfword p)
     }
     vlink(r) = null;
     switch (t) {
+        case attribute_node:
+            attr_interned(r) = 0;
+            break;
         case glyph_node:
             copy_sub_list(lig_ptr(r),lig_ptr(p)) ;
             break;
@@ -1905,6 +2404,8 @@ static void flush_node_wrapup_core(halfword p)
     }
 }
 
+static void unintern_attribute_list(halfword p);
+
 void flush_node(halfword p)
 {
     if (p == null){
@@ -2029,8 +2530,10 @@ void flush_node(halfword p)
         case inserting_node:
         case split_up_node:
         case expr_node:
-        case attribute_node:
         case attribute_list_node:
+            unintern_attribute_list(p);
+            break;
+        case attribute_node:
         case temp_node:
             break;
         default:
@@ -2227,6 +2730,34 @@ halfword fix_node_list(halfword head)
     return tail;
 }
 
+/*tex
+
+    The first slot of a run is returned, the others are pushed on the free chain
+    in reverse order so that successive |get_node| calls hand them out in
+    ascending order. Only the returned slot counts as used.
+
+*/
+
+static halfword get_glyph_run(int s)
+{
+    int i;
+    halfword r = slow_get_node(glyph_run_length * s);
+    for (i = glyph_run_length - 1; i > 0; i--) {
+        halfword q = r + i * s;
+#ifdef CHECK_NODE_USAGE
+        varmem_sizes[q] = 0;
+#endif
+        vlink(q) = free_chain[s];
+        free_chain[s] = q;
+    }
+#ifdef CHECK_NODE_USAGE
+    varmem_sizes[r] = (char) s;
+#endif
+    var_used -= (glyph_run_length - 1) * s;
+    glyph_runs_allocated++;
+    return r;
+}
+
 halfword get_node(int s)
 {
     register halfword r;
@@ -2244,6 +2775,9 @@ halfword get_node(int s)
             return r;
         }
         /*tex This is the end of the \quote {inner loop}. */
+        if (s == glyph_node_size) {
+            return get_glyph_run(s);
+        }
         return slow_get_node(s);
     } else {
         normal_error("nodes","there is a problem in getting a node, case 1");
@@ -2339,6 +2873,11 @@ void init_node_mem(int t)
         overflow("node memory size", (unsigned) var_mem_max);
     }
     memset((void *) (varmem), 0, (unsigned) t * sizeof(memory_word));
+    varmem_properties = (unsigned char *) realloc(varmem_properties, properties_bytes(t));
+    if (varmem_properties == NULL) {
+        overflow("node memory size", (unsigned) var_mem_max);
+    }
+    memset((void *) varmem_properties, 0, properties_bytes(t));
 #ifdef CHECK_NODE_USAGE
     varmem_sizes = (char *) realloc(varmem_sizes, sizeof(char) * (unsigned) t);
     if (varmem_sizes == NULL) {
@@ -2406,6 +2945,7 @@ void undump_node_mem(void)
     var_mem_max = (x < 100000 ? 100000 : x);
     varmem = xmallocarray(memory_word, (unsigned) var_mem_max);
     undump_things(varmem[0], x);
+    varmem_properties = xcalloc(properties_bytes(var_mem_max), 1);
 #ifdef CHECK_NODE_USAGE
     varmem_sizes = xmallocarray(char, (unsigned) var_mem_max);
     memset((void *) varmem_sizes, 0, (unsigned) var_mem_max * sizeof(char));
@@ -2492,6 +3032,12 @@ halfword slow_get_node(int s)
                 overflow("node memory size", (unsigned) var_mem_max);
             }
             memset((void *) (varmem + var_mem_max), 0, (unsigned) x * sizeof(memory_word));
+            varmem_properties = (unsigned char *) realloc(varmem_properties, properties_bytes(var_mem_max + x));
+            if (varmem_properties == NULL) {
+                overflow("node memory size", (unsigned) var_mem_max);
+            }
+            memset((void *) (varmem_properties + properties_bytes(var_mem_max)), 0,
+                properties_bytes(var_mem_max + x) - properties_bytes(var_mem_max));
 #ifdef CHECK_NODE_USAGE
             varmem_sizes = (char *) realloc(varmem_sizes, sizeof(char) * (unsigned) (var_mem_max + x));
             if (varmem_sizes == NULL) {
@@ -2621,6 +3167,146 @@ halfword new_span_node(halfword n, int s, scaled w)
 
 /* Now comes some attribute stuff. */
 
+/*tex
+
+    Attribute lists that are set from \LUA\ are private to a node, so a
+    paragraph where each glyph gets an attribute ends up with as many identical
+    lists. Therefore lists that result from |set_attribute|, |unset_attribute|
+    and the attribute cache are interned: they are kept in a hash table keyed by
+    their content, and a list that is equal to an interned one is replaced by
+    that one. An interned list is never changed in place: it is taken out of the
+    table first. Each table entry also has the (sorted) id and value pairs in an
+    array, which is what |has_attribute| uses.
+
+    The entry of a list is stored in the otherwise unused value field of its
+    head, and is only trusted when the entry points back to the head. The
+    members of an interned list are flagged in their (otherwise unused)
+    subtype, so that the \LUA\ interface can refuse to change them in place.
+
+*/
+
+typedef struct attribute_entry {
+    halfword head;
+    unsigned int hash;
+    int next;
+    int count;
+    int *pairs;
+} attribute_entry;
+
+#define attribute_buckets 4096
+
+static int attribute_bucket[attribute_buckets] = { 0 };
+static attribute_entry *attribute_entries = NULL;
+static int attribute_entries_size = 0;
+static int attribute_entries_free = 0;
+
+int attribute_lists_interned = 0;
+
+#define attribute_list_interned(p) \
+    (attr_list_entry(p) > 0 && attr_list_entry(p) <= attribute_entries_size && \
+     attribute_entries[attr_list_entry(p) - 1].head == (p))
+
+static unsigned int attribute_list_hash(halfword p, int *n)
+{
+    unsigned int h = 2166136261U;
+    int k = 0;
+    p = vlink(p);
+    while (p != null) {
+        h = (h ^ (unsigned int) attribute_id(p)) * 16777619U;
+        h = (h ^ (unsigned int) attribute_value(p)) * 16777619U;
+        k++;
+        p = vlink(p);
+    }
+    *n = k;
+    return h;
+}
+
+static halfword intern_attribute_list(halfword p)
+{
+    int n, e, i;
+    unsigned int h = attribute_list_hash(p, &n);
+    attribute_entry *a;
+    halfword q;
+    /*tex See if we have this one already. */
+    e = attribute_bucket[h & (attribute_buckets - 1)];
+    while (e > 0) {
+        a = &attribute_entries[e - 1];
+        if (a->hash == h && a->count == n) {
+            q = vlink(p);
+            for (i = 0; i < n; i++) {
+                if (attribute_id(q) != a->pairs[2*i] || attribute_value(q) != a->pairs[2*i+1])
+                    break;
+                q = vlink(q);
+            }
+            if (i == n)
+                return a->head;
+        }
+        e = a->next;
+    }
+    /*tex We have a new one. */
+    if (attribute_entries_free > 0) {
+        e = attribute_entries_free;
+        attribute_entries_free = attribute_entries[e - 1].next;
+    } else {
+        if (attribute_entries_size % 256 == 0)
+            attribute_entries = xrealloc(attribute_entries, (unsigned) (attribute_entries_size + 256) * sizeof(attribute_entry));
+        e = ++attribute_entries_size;
+    }
+    a = &attribute_entries[e - 1];
+    a->head = p;
+    a->hash = h;
+    a->count = n;
+    a->pairs = xmalloc((unsigned) (2 * n + 1) * sizeof(int));
+    q = vlink(p);
+    for (i = 0; i < n; i++) {
+        a->pairs[2*i] = attribute_id(q);
+        a->pairs[2*i+1] = attribute_value(q);
+        attr_interned(q) = 1;
+        q = vlink(q);
+    }
+    a->next = attribute_bucket[h & (attribute_buckets - 1)];
+    attribute_bucket[h & (attribute_buckets - 1)] = e;
+    attr_list_entry(p) = e;
+    attribute_lists_interned++;
+    return p;
+}
+
+static void unintern_attribute_list(halfword p)
+{
+    if (attribute_list_interned(p)) {
+        int e = attr_list_entry(p);
+        attribute_entry *a = &attribute_entries[e - 1];
+        int *b = &attribute_bucket[a->hash & (attribute_buckets - 1)];
+        halfword q = vlink(p);
+        while (*b != e)
+            b = &attribute_entries[*b - 1].next;
+        *b = a->next;
+        while (q != null) {
+            attr_interned(q) = 0;
+            q = vlink(q);
+        }
+        xfree(a->pairs);
+        a->head = null;
+        a->next = attribute_entries_free;
+        attribute_entries_free = e;
+        attr_list_entry(p) = 0;
+        attribute_lists_interned--;
+    }
+}
+
+/*tex Replace the (private) list of |n| by its interned version. */
+
+static void share_attribute_list(halfword n)
+{
+    halfword p = node_attr(n);
+    halfword q = intern_attribute_list(p);
+    if (q != p) {
+        attr_list_ref(q)++;
+        node_attr(n) = q;
+        delete_attribute_ref(p);
+    }
+}
+
 static halfword new_attribute_node(unsigned int i, int v)
 {
     register halfword r = get_node(attribute_node_size);
@@ -2638,11 +3324,13 @@ halfword copy_attribute_list(halfword n)
     register halfword p = q;
     type(p) = attribute_list_node;
     attr_list_ref(p) = 0;
+    attr_list_entry(p) = 0;
     n = vlink(n);
     while (n != null) {
         register halfword r = get_node(attribute_node_size);
         /*tex The link will be fixed automatically in the next loop. */
         (void) memcpy((void *) (varmem + r), (void *) (varmem + n), (sizeof(memory_word) * attribute_node_size));
+        attr_interned(r) = 0;
         vlink(p) = r;
         p = r;
         n = vlink(n);
@@ -2650,13 +3338,93 @@ halfword copy_attribute_list(halfword n)
     return q;
 }
 
+/*tex
+
+    Every \.{\attribute} assignment and every group end disables the attribute
+    cache, and with attributes toggled in many small groups the list gets rebuilt
+    all the time, often into a state that we had just before. So we keep the
+    last few states, keyed by a hash of the attribute registers, and when we
+    return to one of them its list is reused without allocating anything. Each
+    remembered list has one reference that is given back when it drops out.
+
+*/
+
+#define attribute_states 8
+
+typedef struct attribute_state {
+    unsigned int hash;
+    halfword list;
+} attribute_state;
+
+static attribute_state attribute_state_cache[attribute_states];
+static int attribute_state_count = 0;
+
+static boolean attribute_state_matches(halfword p)
+{
+    register int i;
+    if (p != null)
+        p = vlink(p);
+    for (i = 0; i <= max_used_attr; i++) {
+        register int v = attribute(i);
+        if (v > UNUSED_ATTRIBUTE) {
+            if (p == null || attribute_id(p) != i || attribute_value(p) != v)
+                return false;
+            p = vlink(p);
+        }
+    }
+    return (p == null);
+}
+
+/*tex
+
+    Before a format is dumped the remembered states are given back and the
+    intern table is emptied, because it is not part of the format. Lists that
+    are still used stay shared, but become ordinary ones.
+
+*/
+
+void flush_attribute_states(void)
+{
+    int e;
+    while (attribute_state_count > 0) {
+        attribute_state_count--;
+        delete_attribute_ref(attribute_state_cache[attribute_state_count].list);
+    }
+    for (e = 0; e < attribute_entries_size; e++) {
+        if (attribute_entries[e].head != null) {
+            unintern_attribute_list(attribute_entries[e].head);
+        }
+    }
+}
+
 void update_attribute_cache(void)
 {
     halfword p;
     register int i;
+    unsigned int h = 2166136261U;
+    attribute_state s;
+    for (i = 0; i <= max_used_attr; i++) {
+        register int v = attribute(i);
+        if (v > UNUSED_ATTRIBUTE) {
+            h = (h ^ (unsigned int) i) * 16777619U;
+            h = (h ^ (unsigned int) v) * 16777619U;
+        }
+    }
+    for (i = 0; i < attribute_state_count; i++) {
+        s = attribute_state_cache[i];
+        if (s.hash == h && attribute_state_matches(s.list)) {
+            /*tex Move the hit to the front. */
+            for (; i > 0; i--)
+                attribute_state_cache[i] = attribute_state_cache[i - 1];
+            attribute_state_cache[0] = s;
+            attr_list_cache = s.list;
+            return;
+        }
+    }
     attr_list_cache = get_node(attribute_node_size);
     type(attr_list_cache) = attribute_list_node;
     attr_list_ref(attr_list_cache) = 0;
+    attr_list_entry(attr_list_cache) = 0;
     p = attr_list_cache;
     for (i = 0; i <= max_used_attr; i++) {
         register int v = attribute(i);
@@ -2669,17 +3437,36 @@ void update_attribute_cache(void)
     if (vlink(attr_list_cache) == null) {
         free_node(attr_list_cache, attribute_node_size);
         attr_list_cache = null;
+    } else {
+        p = intern_attribute_list(attr_list_cache);
+        if (p != attr_list_cache) {
+            free_node_chain(attr_list_cache, attribute_node_size);
+            attr_list_cache = p;
+        }
+    }
+    /*tex Remember this state, the oldest one drops out. */
+    if (attribute_state_count == attribute_states) {
+        attribute_state_count--;
+        delete_attribute_ref(attribute_state_cache[attribute_state_count].list);
     }
+    for (i = attribute_state_count; i > 0; i--)
+        attribute_state_cache[i] = attribute_state_cache[i - 1];
+    attribute_state_cache[0].hash = h;
+    attribute_state_cache[0].list = attr_list_cache;
+    add_node_attr_ref(attr_list_cache);
+    attribute_state_count++;
     return;
 }
 
 void build_attribute_list(halfword b)
 {
     if (max_used_attr >= 0) {
-        if (attr_list_cache == cache_disabled|| attr_list_cache == null) {
+        if (attr_list_cache == cache_disabled) {
             update_attribute_cache();
-            if (attr_list_cache == null)
-                return;
+        }
+        if (attr_list_cache == null) {
+            /*tex No attributes are set. */
+            return;
         }
         attr_list_ref(attr_list_cache)++;
         node_attr(b) = attr_list_cache;
@@ -2727,6 +3514,7 @@ void delete_attribute_ref(halfword b)
             if (attr_list_ref(b) == 0) {
                 if (b == attr_list_cache)
                     attr_list_cache = cache_disabled;
+                unintern_attribute_list(b);
                 free_node_chain(b, attribute_node_size);
             }
             /*tex Maintain sanity. */
@@ -2757,6 +3545,7 @@ halfword do_set_attribute(halfword p, int i, int val)
         q = get_node(attribute_node_size);
         type(q) = attribute_list_node;
         attr_list_ref(q) = 1;
+        attr_list_entry(q) = 0;
         p = new_attribute_node((unsigned) i, val);
         vlink(q) = p;
         return q;
@@ -2774,6 +3563,7 @@ halfword do_set_attribute(halfword p, int i, int val)
             j++;
             p = vlink(p);
         }
+        unintern_attribute_list(q);
         p = q;
         while (j-- > 0)
             p = vlink(p);
@@ -2805,9 +3595,11 @@ void set_attribute(halfword n, int i, int val)
         p = get_node(attribute_node_size);
         type(p) = attribute_list_node;
         attr_list_ref(p) = 1;
+        attr_list_entry(p) = 0;
         node_attr(n) = p;
         p = new_attribute_node((unsigned) i, val);
         vlink(node_attr(n)) = p;
+        share_attribute_list(n);
         return;
     }
     /*tex We check if we have this attribute already and quit if the value stays the same. */
@@ -2828,8 +3620,10 @@ void set_attribute(halfword n, int i, int val)
             formatted_warning("nodes","node %d has an attribute list that is free already, case 1",(int) n);
             /*tex The still dangling list gets ref count 1. */
             attr_list_ref(p) = 1;
+            unintern_attribute_list(p);
         } else if (attr_list_ref(p) == 1) {
             /*tex This can really happen! */
+            unintern_attribute_list(p);
             if (p == attr_list_cache) {
                 /*tex
 
@@ -2863,6 +3657,7 @@ void set_attribute(halfword n, int i, int val)
             vlink(r) = vlink(p);
             vlink(p) = r;
         }
+        share_attribute_list(n);
     } else {
         normal_error("nodes","trying to set an attribute fails, case 2");
     }
@@ -2897,7 +3692,12 @@ int unset_attribute(halfword n, int i, int val)
         if (attribute_id(p) != i)
             return UNUSED_ATTRIBUTE;
         /*tex If we are still here, the attribute exists. */
+        t = attribute_value(p);
         p = node_attr(n);
+        if (val != UNUSED_ATTRIBUTE && t != val) {
+            /*tex Nothing changes. */
+            return t;
+        }
         if (attr_list_ref(p) > 1 || p == attr_list_cache) {
             halfword q = copy_attribute_list(p);
             if (attr_list_ref(p) > 1) {
@@ -2905,14 +3705,14 @@ int unset_attribute(halfword n, int i, int val)
             }
             attr_list_ref(q) = 1;
             node_attr(n) = q;
+        } else {
+            unintern_attribute_list(p);
         }
         p = vlink(node_attr(n));
         while (j-- > 0)
             p = vlink(p);
-        t = attribute_value(p);
-        if (val == UNUSED_ATTRIBUTE || t == val) {
-            attribute_value(p) = UNUSED_ATTRIBUTE;
-        }
+        attribute_value(p) = UNUSED_ATTRIBUTE;
+        share_attribute_list(n);
         return t;
     } else {
         normal_error("nodes","trying to unset an attribute fails");
@@ -2928,6 +3728,27 @@ int has_attribute(halfword n, int i, int val)
     p = node_attr(n);
     if (p == null || vlink(p) == null)
         return UNUSED_ATTRIBUTE;
+    if (attribute_list_interned(p)) {
+        /*tex A binary search in the compact copy. */
+        attribute_entry *a = &attribute_entries[attr_list_entry(p) - 1];
+        int l = 0;
+        int h = a->count - 1;
+        while (l <= h) {
+            int m = (l + h) / 2;
+            int t = a->pairs[2*m];
+            if (t == i) {
+                int ret = a->pairs[2*m+1];
+                if (val == UNUSED_ATTRIBUTE || val == ret)
+                    return ret;
+                return UNUSED_ATTRIBUTE;
+            } else if (t < i) {
+                l = m + 1;
+            } else {
+                h = m - 1;
+            }
+        }
+        return UNUSED_ATTRIBUTE;
+    }
     p = vlink(p);
     while (p != null) {
         if (attribute_id(p) == i) {
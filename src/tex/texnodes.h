@@ -75,6 +75,8 @@ extern void undump_node_mem(void);
 #  define attr_list_ref(a)   vinfo((a)+1) /* the reference count */
 #  define attribute_id(a)    vinfo((a)+1)
 #  define attribute_value(a) vlink((a)+1)
+#  define attr_list_entry(a) vlink((a)+1) /* the intern table entry of a list head */
+#  define attr_interned(a)   subtype(a)   /* set in the members of an interned list */
 
 #  define assign_attribute_ref(n,p) do {     \
         node_attr(n) = p;attr_list_ref(p)++; \
@@ -90,7 +92,9 @@ extern void undump_node_mem(void);
 } while (0)
 
 extern void update_attribute_cache(void);
+extern void flush_attribute_states(void);
 extern halfword copy_attribute_list(halfword n);
+extern int attribute_lists_interned;
 extern halfword do_set_attribute(halfword p, int i, int val);
 
 #  define width_offset 2
@@ -936,6 +940,8 @@ extern void flush_node_list(halfword);
 extern void flush_node(halfword);
 extern halfword do_copy_node_list(halfword, halfword);
 extern halfword copy_node_list(halfword);
+extern uint64_t hash_node_list(halfword p, int *complete);
+extern boolean same_node_list(halfword p, halfword q);
 extern halfword copy_node(const halfword);
 extern void check_node(halfword);
 extern halfword fix_node_list(halfword);
@@ -944,6 +950,7 @@ extern char *sprint_node_mem_usage(void);
 extern halfword raw_glyph_node(void);
 extern halfword new_glyph_node(void);
 extern int valid_node(halfword);
+extern boolean mark_node_strings(void);
 
 typedef enum {
     normal_g = 0, /* normal */
@@ -984,6 +991,7 @@ typedef enum {
 extern halfword tail_of_list(halfword p);
 
 extern int var_used;
+extern int glyph_runs_allocated;
 
 #  define cache_disabled max_halfword
 
@@ -1010,6 +1018,14 @@ extern halfword new_penalty(int m, int s);
 extern int lua_properties_enabled ;
 extern int lua_properties_level ;
 extern int lua_properties_use_metatable ;
+extern int lua_properties_untracked ;
+
+extern unsigned char *varmem_properties;
+
+#  define properties_bytes(n) ((size_t) (((n) + 7) >> 3))
+#  define node_has_properties(a) (varmem_properties[(a) >> 3] & (1 << ((a) & 7)))
+#  define set_node_has_properties(a) varmem_properties[(a) >> 3] |= (unsigned char) (1 << ((a) & 7))
+#  define reset_node_has_properties(a) varmem_properties[(a) >> 3] &= (unsigned char) ~(1 << ((a) & 7))
 
 extern halfword make_local_par_node(int mode);
 
@@ -39,6 +39,30 @@ static sa_tree *catcode_heads = NULL;
 static int catcode_max = 0;
 static unsigned char *catcode_valid = NULL;
 
+/*tex
+
+    The tokenizer's fast path for runs of characters wants the codes of the
+    \ASCII\ range without going through the tree, so we keep a dense copy of
+    that part of the table that was asked for last. Any change to any table
+    drops the copy.
+
+*/
+
+static halfword ascii_cat_codes[128];
+static int ascii_cat_codes_table = -1;
+
+halfword *get_ascii_cat_codes(int h)
+{
+    if (h != ascii_cat_codes_table) {
+        int k;
+        for (k = 0; k < 128; k++) {
+            ascii_cat_codes[k] = get_cat_code(h, k);
+        }
+        ascii_cat_codes_table = h;
+    }
+    return ascii_cat_codes;
+}
+
 void set_cat_code(int h, int n, halfword v, quarterword gl)
 {
     sa_tree_item sa_value = { 0 };
@@ -52,6 +76,7 @@ void set_cat_code(int h, int n, halfword v, quarterword gl)
     }
     sa_value.int_value = (int) v;
     set_sa_item(s, n, sa_value, gl);
+    ascii_cat_codes_table = -1;
 }
 
 halfword get_cat_code(int h, int n)
@@ -74,8 +99,10 @@ void unsave_cat_codes(int h, quarterword gl)
     if (h > catcode_max)
         catcode_max = h;
     for (k = 0; k <= catcode_max; k++) {
-        if (catcode_heads[k] != NULL)
+        if (catcode_heads[k] != NULL && catcode_heads[k]->stack_ptr > 0) {
             restore_sa_stack(catcode_heads[k], gl);
+            ascii_cat_codes_table = -1;
+        }
     }
 }
 
@@ -120,6 +147,7 @@ static void undumpcatcodes(void)
     catcode_valid = Mxmalloc_array(unsigned char, (CATCODE_MAX + 1));
     memset(catcode_heads, 0, sizeof(sa_tree) * (CATCODE_MAX + 1));
     memset(catcode_valid, 0, sizeof(unsigned char) * (CATCODE_MAX + 1));
+    ascii_cat_codes_table = -1;
     undump_int(catcode_max);
     undump_int(total);
     for (k = 0; k < total; k++) {
@@ -147,6 +175,7 @@ void copy_cat_codes(int from, int to)
     destroy_sa_tree(catcode_heads[to]);
     catcode_heads[to] = copy_sa_tree(catcode_heads[from]);
     catcode_valid[to] = 1;
+    ascii_cat_codes_table = -1;
 }
 
 void initex_cat_codes(int h)
@@ -24,6 +24,7 @@
 
 void set_cat_code(int h, int n, halfword v, quarterword gl);
 halfword get_cat_code(int h, int n);
+halfword *get_ascii_cat_codes(int h);
 int valid_catcode_table(int h);
 void unsave_cat_codes(int h, quarterword gl);
 void copy_cat_codes(int from, int to);
@@ -471,6 +471,29 @@ void show_token_list(int p, int q, int l)
         tprint_esc("ETC.");
 }
 
+/*tex
+
+    Arguments can share the tokens of a macro body (see |macro_call|), in which
+    case they end before the token |e| instead of at |null|. We temporarily cut
+    the list there; nothing else looks at it while we print.
+
+*/
+
+void show_token_span(int p, int e, int q, int l)
+{
+    halfword r = p;
+    if (p == e) {
+        show_token_list(null, q, l);
+        return;
+    }
+    while (token_link(r) != e) {
+        r = token_link(r);
+    }
+    set_token_link(r, null);
+    show_token_list(p, q, l);
+    set_token_link(r, e);
+}
+
 #define do_buffer_to_unichar(a,b) do { \
     a = (halfword)str2uni(buffer+b); \
     b += utf8_size(a); \
@@ -509,6 +532,75 @@ void delete_token_ref(halfword p)
         decr(token_ref_count(p));
 }
 
+/*tex
+
+    When |\internmacrosmode| is positive, macro bodies that are identical to one
+    defined earlier share that earlier list instead of keeping their own copy.
+    This pays off for the many small definitions (often just |\def\x{}|) that
+    key-value and similar packages generate in loops. The table is direct mapped
+    on a hash of the token sequence and only short bodies are considered; each
+    entry holds one reference, which is released when the slot is reused. Token
+    lists that are stored as macro bodies are never changed in place, so sharing
+    them is safe; |\let| has always done the same.
+
+*/
+
+#  define intern_size 1024
+#  define intern_max_length 64
+
+static halfword intern_table[intern_size] = { null };
+
+halfword intern_token_list(halfword r)
+{
+    unsigned int h = 2166136261U;
+    int n = 0;
+    halfword p = token_link(r);
+    halfword q;
+    while (p != null) {
+        if (++n > intern_max_length)
+            return r;
+        h = (h ^ (unsigned int) token_info(p)) * 16777619U;
+        p = token_link(p);
+    }
+    h = (h ^ (unsigned int) n) & (intern_size - 1);
+    q = intern_table[h];
+    if (q != null) {
+        p = token_link(r);
+        q = token_link(q);
+        while (p != null && q != null && token_info(p) == token_info(q)) {
+            p = token_link(p);
+            q = token_link(q);
+        }
+        if (p == null && q == null) {
+            flush_list(r);
+            add_token_ref(intern_table[h]);
+            return intern_table[h];
+        }
+        delete_token_ref(intern_table[h]);
+    }
+    add_token_ref(r);
+    intern_table[h] = r;
+    return r;
+}
+
+/*tex
+
+    The table is emptied before a format is dumped, because its references
+    would otherwise end up in the format without an owner.
+
+*/
+
+void flush_interned_token_lists(void)
+{
+    int i;
+    for (i = 0; i < intern_size; i++) {
+        if (intern_table[i] != null) {
+            delete_token_ref(intern_table[i]);
+            intern_table[i] = null;
+        }
+    }
+}
+
 int get_char_cat_code(int curchr)
 {
     int a;
@@ -2018,7 +2110,11 @@ static boolean get_next_tokenlist(void)
                 break;
             case out_param_cmd:
                 /*tex Insert macro parameter and |goto restart|. */
-                begin_token_list(param_stack[param_start + cur_chr - 1], parameter);
+                {
+                    int k = param_start + cur_chr - 1;
+                    begin_token_list(param_stack[k], parameter);
+                    param_end = (param_span_stack[k].ref != null) ? param_span_stack[k].end : null;
+                }
                 return false;
                 break;
         }
@@ -2044,7 +2140,7 @@ void get_next(void)
         if (!get_next_file())
             goto RESTART;
     } else {
-        if (iloc == null) {
+        if (token_list_done()) {
             end_token_list();
             /*tex List exhausted, resume previous level. */
             goto RESTART;
@@ -2060,6 +2156,48 @@ void get_next(void)
     }
 }
 
+/*tex
+
+    Most of the characters in a document are letters and other characters in
+    the middle of a line of a file. When |main_control| has just appended such
+    a character, it can ask for the next one with |get_next_char|, which
+    returns |true| and sets |cur_cmd|, |cur_chr| and |cur_tok| as |get_x_token|
+    would, but only when the next character is a plain \ASCII\ letter or other
+    character in the current line; in all other cases nothing is consumed and
+    the normal route has to be taken. The catcodes of the \ASCII\ range come
+    from a dense copy of the table.
+
+*/
+
+boolean get_next_char(void)
+{
+    int c;
+    halfword cat;
+    if (istate != mid_line || iloc > ilimit || detokenized_line()) {
+        return false;
+    }
+    c = buffer[iloc];
+    if (c >= 0x80) {
+        return false;
+    }
+    if (line_catcode_table == DEFAULT_CAT_TABLE) {
+        cat = get_ascii_cat_codes(cat_code_table_par)[c];
+    } else if (line_catcode_table > -0xFF) {
+        cat = get_ascii_cat_codes(line_catcode_table)[c];
+    } else {
+        cat = - line_catcode_table - 0xFF;
+    }
+    if (cat != letter_cmd && cat != other_char_cmd) {
+        return false;
+    }
+    iloc++;
+    cur_cs = 0;
+    cur_cmd = cat;
+    cur_chr = c;
+    cur_tok = token_val(cur_cmd, cur_chr);
+    return true;
+}
+
 /*tex
 
     Since |get_next| is used so frequently in \TeX, it is convenient to define
@@ -2773,7 +2911,7 @@ void conv_toks(void)
                 scan_toks(false, true);
                 bool = in_lua_escape;
                 in_lua_escape = true;
-                escstr.s = (unsigned char *) tokenlist_to_cstring(def_ref, false, &l);
+                escstr.s = (unsigned char *) tokenlist_to_tstring(def_ref, false, &l);
                 escstr.l = (unsigned) l;
                 in_lua_escape = bool;
                 delete_token_ref(def_ref);
@@ -2782,7 +2920,6 @@ void conv_toks(void)
                 scanner_status = save_scanner_status;
                 (void) lua_str_toks(escstr);
                 ins_list(token_link(temp_token_head));
-                free(escstr.s);
                 return;
             }
             /*tex no further action */
@@ -3234,18 +3371,26 @@ str_number tokens_to_string(halfword p)
 
 /*tex
 
-    Values like 512 and 128 also work ok. There is not much to gain in
-    optimization here.
+    Token lists are serialized into a scratch buffer that is kept between calls
+    and grows by doubling, so in the normal case there is no allocation at all.
+    Callers that consume the result right away (pushing it to \LUA, looking up a
+    control sequence, loading a chunk) use |tokenlist_to_tstring| and get the
+    scratch buffer itself; it is valid until the next serialization. The other
+    variants return a copy.
 
 */
 
 #define alloci_default 1024
-#define alloci_step     256
 
-#define make_room(a)                     \
-    if ((unsigned)i+a+1>alloci) {        \
-        ret = xrealloc(ret,(alloci+alloci_step)); \
-        alloci = alloci + alloci_step; \
+static char *token_scratch = NULL;
+static unsigned token_scratch_size = 0;
+
+#define make_room(a)                                   \
+    if ((unsigned)i+a+1>alloci) {                      \
+        alloci = 2*alloci;                             \
+        if ((unsigned)i+a+1>alloci)                    \
+            alloci = (unsigned)i+a+1;                  \
+        ret = xrealloc(ret,alloci);                    \
     }
 
 #define append_i_byte(a) ret[i++] = (char)(a)
@@ -3272,7 +3417,9 @@ str_number tokens_to_string(halfword p)
       append_i_byte(0x80 + (((s % 0x40000) % 0x1000) % 0x40)); \
     } }
 
-#define Print_esc(b) {                     \
+/*tex In |body| mode we only want the body of a macro and keep silent about errors. */
+
+#define Print_esc(b) if (!body) {          \
     const char *v = b;                     \
     if (e>0 && e<STRING_OFFSET) {          \
         Print_uchar (e);                   \
@@ -3298,27 +3445,25 @@ str_number tokens_to_string(halfword p)
 
 */
 
-char *tokenlist_to_cstring(int pp, int inhibit_par, int *siz)
+static int tokenlist_to_scratch(int pp, int inhibit_par, int body)
 {
     register int p, c, m;
     int q;
     int infop;
     char *s, *sh;
     int e = 0;
-    char *ret;
+    char *ret = token_scratch;
     int match_chr = '#';
     int n = '0';
-    unsigned alloci = alloci_default;
+    unsigned alloci = token_scratch_size;
     int i = 0;
-    p = pp;
-    if (p == null) {
-        if (siz != NULL)
-            *siz = 0;
-        return NULL;
+    int skipping = body;
+    if (ret == NULL) {
+        alloci = alloci_default;
+        ret = xmalloc(alloci);
     }
-    ret = xmalloc(alloci);
     /*tex Skip refcount. */
-    p = token_link(p);
+    p = token_link(pp);
     if (p != null) {
         e = escape_char_par;
     }
@@ -3342,130 +3487,6 @@ char *tokenlist_to_cstring(int pp, int inhibit_par, int *siz)
                     Print_esc("IMPOSSIBLE.");
                 } else if ((cs_text(q) < 0) || (cs_text(q) >= str_ptr)) {
                     Print_esc("NONEXISTENT.");
-                } else {
-                    str_number txt = cs_text(q);
-                    sh = makecstring(txt);
-                    s = sh;
-                    if (is_active_cs(txt)) {
-                        s = s + 3;
-                        while (*s) {
-                            Print_char(*s);
-                            s++;
-                        }
-                    } else {
-                        if (e>=0 && e<0x110000) Print_uchar(e);
-                        while (*s) {
-                            Print_char(*s);
-                            s++;
-                        }
-                        if ((!single_letter(txt)) || is_cat_letter(txt)) {
-                            Print_char(' ');
-                        }
-                    }
-                    free(sh);
-                }
-            }
-        } else {
-            if (infop < 0) {
-                Print_esc("BAD");
-            } else {
-                m = token_cmd(infop);
-                c = token_chr(infop);
-                switch (m) {
-                    case left_brace_cmd:
-                    case right_brace_cmd:
-                    case math_shift_cmd:
-                    case tab_mark_cmd:
-                    case sup_mark_cmd:
-                    case sub_mark_cmd:
-                    case spacer_cmd:
-                    case letter_cmd:
-                    case other_char_cmd:
-                        Print_uchar(c);
-                        break;
-                    case mac_param_cmd:
-                        if (!in_lua_escape && (is_in_csname==0))
-                            Print_uchar(c);
-                        Print_uchar(c);
-                        break;
-                    case out_param_cmd:
-                        Print_uchar(match_chr);
-                        if (c <= 9) {
-                            Print_char(c + '0');
-                        } else {
-                            Print_char('!');
-                            goto EXIT;
-                        }
-                        break;
-                    case match_cmd:
-                        match_chr = c;
-                        Print_uchar(c);
-                        n++;
-                        Print_char(n);
-                        if (n > '9')
-                            goto EXIT;
-                        break;
-                    case end_match_cmd:
-                        if (c == 0) {
-                            Print_char('-');
-                            Print_char('>');
-                        }
-                        break;
-                    default:
-                        not_so_bad(Print_esc);
-                        break;
-                }
-            }
-        }
-        p = token_link(p);
-    }
-  EXIT:
-    ret[i] = '\0';
-    if (siz != NULL)
-        *siz = i;
-    return ret;
-}
-
-char *tokenlist_to_xstring(int pp, int inhibit_par, int *siz)
-{
-    register int p, c, m;
-    int q;
-    int infop;
-    char *s, *sh;
-    int e = 0;
-    char *ret;
-    int match_chr = '#';
-    int n = '0';
-    unsigned alloci = alloci_default;
-    int i = 0;
-    int skipping = 1;
-    p = pp;
-    if (p == null) {
-        if (siz != NULL)
-            *siz = 0;
-        return NULL;
-    }
-    ret = xmalloc(alloci);
-    /*tex Skip refcount. */
-    p = token_link(p);
-    if (p != null) {
-        e = escape_char_par;
-    }
-    while (p != null) {
-        if (p < (int) fix_mem_min || p > (int) fix_mem_end) {
-            /*tex Nothing done. */
-            break;
-        }
-        infop = token_info(p);
-        if (infop >= cs_token_flag) {
-            if (!(inhibit_par && infop == par_token)) {
-                q = infop - cs_token_flag;
-                if (q < hash_base) {
-                    /*tex Nothing done. */
-                } else if ((q >= undefined_control_sequence) && ((q <= eqtb_size) || (q > eqtb_size + hash_extra))) {
-                    /*tex Nothing done. */
-                } else if ((cs_text(q) < 0) || (cs_text(q) >= str_ptr)) {
-                    /*tex Nothing done. */
                 } else if (!skipping) {
                     str_number txt = cs_text(q);
                     sh = makecstring(txt);
@@ -3491,7 +3512,7 @@ char *tokenlist_to_xstring(int pp, int inhibit_par, int *siz)
             }
         } else {
             if (infop < 0) {
-                /*tex Nothing done. */
+                Print_esc("BAD");
             } else {
                 m = token_cmd(infop);
                 c = token_chr(infop);
@@ -3509,7 +3530,7 @@ char *tokenlist_to_xstring(int pp, int inhibit_par, int *siz)
                             Print_uchar(c);
                         }
                         break;
-                   case mac_param_cmd:
+                    case mac_param_cmd:
                         if (!skipping) {
                             if (!in_lua_escape && (is_in_csname==0))
                                 Print_uchar(c);
@@ -3525,7 +3546,9 @@ char *tokenlist_to_xstring(int pp, int inhibit_par, int *siz)
                                 Print_char(c + '0');
                             }
                         } else {
-                            /*tex Nothing done. */
+                            if (!body) {
+                                Print_char('!');
+                            }
                             goto EXIT;
                         }
                         break;
@@ -3547,12 +3570,14 @@ char *tokenlist_to_xstring(int pp, int inhibit_par, int *siz)
                                 Print_char('-');
                                 Print_char('>');
                             }
-                            i = 0;
-                            skipping = 0 ;
+                            if (body) {
+                                i = 0;
+                                skipping = 0;
+                            }
                         }
                         break;
                     default:
-                        /*tex Nothing done. */
+                        not_so_bad(Print_esc);
                         break;
                 }
             }
@@ -3561,11 +3586,54 @@ char *tokenlist_to_xstring(int pp, int inhibit_par, int *siz)
     }
   EXIT:
     ret[i] = '\0';
+    token_scratch = ret;
+    token_scratch_size = alloci;
+    return i;
+}
+
+const char *tokenlist_to_tstring(int pp, int inhibit_par, int *siz)
+{
+    int i;
+    if (pp == null) {
+        if (siz != NULL)
+            *siz = 0;
+        return NULL;
+    }
+    i = tokenlist_to_scratch(pp, inhibit_par, 0);
+    if (siz != NULL)
+        *siz = i;
+    return token_scratch;
+}
+
+static char *copy_token_scratch(int i, int *siz)
+{
+    char *ret = xmalloc((unsigned) (i + 1));
+    memcpy(ret, token_scratch, (size_t) (i + 1));
     if (siz != NULL)
         *siz = i;
     return ret;
 }
 
+char *tokenlist_to_cstring(int pp, int inhibit_par, int *siz)
+{
+    if (pp == null) {
+        if (siz != NULL)
+            *siz = 0;
+        return NULL;
+    }
+    return copy_token_scratch(tokenlist_to_scratch(pp, inhibit_par, 0), siz);
+}
+
+char *tokenlist_to_xstring(int pp, int inhibit_par, int *siz)
+{
+    if (pp == null) {
+        if (siz != NULL)
+            *siz = 0;
+        return NULL;
+    }
+    return copy_token_scratch(tokenlist_to_scratch(pp, inhibit_par, 1), siz);
+}
+
 lstring *tokenlist_to_lstring(int pp, int inhibit_par)
 {
     int siz;
@@ -102,6 +102,7 @@ extern void print_meaning(void);
 
 extern void flush_list(halfword p);
 extern void show_token_list(int p, int q, int l);
+extern void show_token_span(int p, int e, int q, int l);
 extern void token_show(halfword p);
 
 #  define token_ref_count(a) token_info((a))    /* reference count preceding a token list */
@@ -117,6 +118,8 @@ extern void token_show(halfword p);
   } while (0)
 
 extern void delete_token_ref(halfword p);
+extern halfword intern_token_list(halfword r);
+extern void flush_interned_token_lists(void);
 
 extern void make_token_table(lua_State * L, int cmd, int chr, int cs);
 
@@ -124,6 +127,7 @@ extern void make_token_table(lua_State * L, int cmd, int chr, int cs);
 #  define  DEFAULT_CAT_TABLE -1
 
 extern void get_next(void);
+extern boolean get_next_char(void);
 extern void check_outer_validity(void);
 extern boolean scan_keyword(const char *);
 extern boolean scan_keyword_case_sensitive(const char *);
@@ -177,6 +181,7 @@ extern str_number tokens_to_string(halfword p); /* return a string from tokens l
 
 extern char *tokenlist_to_xstring(int p, int inhibit_par, int *siz);
 extern char *tokenlist_to_cstring(int p, int inhibit_par, int *siz);
+extern const char *tokenlist_to_tstring(int p, int inhibit_par, int *siz);
 extern lstring *tokenlist_to_lstring(int pp, int inhibit_par);
 extern void free_lstring(lstring * ls);
 